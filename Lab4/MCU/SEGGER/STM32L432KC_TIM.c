@@ -31,7 +31,31 @@ void initTIM15(void){
     TIM15->TIM15_CR1   |= (0b1);
 }
 
+volatile uint32_t tim15Millis = 0;
+static void (*tim15Hook)(void) = 0;
+
+void enableTIM15Tick(void (*hook)(void)) {
+    tim15Hook = hook;
+    TIM15->TIM15_SR   &= ~(0b1);
+    TIM15->TIM15_DIER |= 1;                      // Update interrupt enable (UIE)
+    NVIC_ISER0 = (1UL << TIM1_BRK_TIM15_IRQn);
+}
+
+// 1 ms update event
+void TIM1_BRK_TIM15_IRQHandler(void) {
+    TIM15->TIM15_SR &= ~(0b1);
+    tim15Millis++;
+    if (tim15Hook) tim15Hook();
+}
+
 void DelayTIM15(uint32_t ms){
+    // The ISR owns UIF once the tick is on, so wait on its count instead
+    if (TIM15->TIM15_DIER & 1) {
+        uint32_t start = tim15Millis;
+        while ((tim15Millis - start) < ms);
+        return;
+    }
+
     // reset counter
     TIM15->TIM15_CNT  = 0;
     // clear flag
@@ -75,28 +99,97 @@ void initTIM16(void) {
 }
 
 
-void setTIM16_freq(uint32_t freq) {
-    // Disable counter
-    TIM16->TIM16_CR1 &= ~1;
+// Equal-tempered notes from NOTE_MIDI_MIN to NOTE_MIDI_MAX, frequencies in millihertz.
+// Higher pitches (up to 20 kHz) go through setTIM16_freq() and pwmSearch().
+const PWM_Setting noteTable[NOTE_MIDI_MAX - NOTE_MIDI_MIN + 1] = {
+  PWM_SETTING(20602), PWM_SETTING(21827), PWM_SETTING(23125), PWM_SETTING(24500), PWM_SETTING(25957), PWM_SETTING(27500), PWM_SETTING(29135), PWM_SETTING(30868), // E0-B0
+  PWM_SETTING(32703), PWM_SETTING(34648), PWM_SETTING(36708), PWM_SETTING(38891), PWM_SETTING(41203), PWM_SETTING(43654), PWM_SETTING(46249), PWM_SETTING(48999), PWM_SETTING(51913), PWM_SETTING(55000), PWM_SETTING(58270), PWM_SETTING(61735), // C1-B1
+  PWM_SETTING(65406), PWM_SETTING(69296), PWM_SETTING(73416), PWM_SETTING(77782), PWM_SETTING(82407), PWM_SETTING(87307), PWM_SETTING(92499), PWM_SETTING(97999), PWM_SETTING(103826), PWM_SETTING(110000), PWM_SETTING(116541), PWM_SETTING(123471), // C2-B2
+  PWM_SETTING(130813), PWM_SETTING(138591), PWM_SETTING(146832), PWM_SETTING(155563), PWM_SETTING(164814), PWM_SETTING(174614), PWM_SETTING(184997), PWM_SETTING(195998), PWM_SETTING(207652), PWM_SETTING(220000), PWM_SETTING(233082), PWM_SETTING(246942), // C3-B3
+  PWM_SETTING(261626), PWM_SETTING(277183), PWM_SETTING(293665), PWM_SETTING(311127), PWM_SETTING(329628), PWM_SETTING(349228), PWM_SETTING(369994), PWM_SETTING(391995), PWM_SETTING(415305), PWM_SETTING(440000), PWM_SETTING(466164), PWM_SETTING(493883), // C4-B4
+  PWM_SETTING(523251), PWM_SETTING(554365), PWM_SETTING(587330), PWM_SETTING(622254), PWM_SETTING(659255), PWM_SETTING(698456), PWM_SETTING(739989), PWM_SETTING(783991), PWM_SETTING(830609), PWM_SETTING(880000), PWM_SETTING(932328), PWM_SETTING(987767), // C5-B5
+  PWM_SETTING(1046502), PWM_SETTING(1108731), PWM_SETTING(1174659), PWM_SETTING(1244508), PWM_SETTING(1318510), PWM_SETTING(1396913), PWM_SETTING(1479978), PWM_SETTING(1567982), PWM_SETTING(1661219), PWM_SETTING(1760000), PWM_SETTING(1864655), PWM_SETTING(1975533), // C6-B6
+  PWM_SETTING(2093005), PWM_SETTING(2217461), PWM_SETTING(2349318), PWM_SETTING(2489016), PWM_SETTING(2637020), PWM_SETTING(2793826), PWM_SETTING(2959955), PWM_SETTING(3135963), PWM_SETTING(3322438), PWM_SETTING(3520000), PWM_SETTING(3729310), PWM_SETTING(3951066), // C7-B7
+  PWM_SETTING(4186009), PWM_SETTING(4434922), PWM_SETTING(4698636), PWM_SETTING(4978032), PWM_SETTING(5274041), PWM_SETTING(5587652), PWM_SETTING(5919911), PWM_SETTING(6271927), PWM_SETTING(6644875), PWM_SETTING(7040000), PWM_SETTING(7458620), PWM_SETTING(7902133), // C8-B8
+  PWM_SETTING(8372018), PWM_SETTING(8869844), PWM_SETTING(9397273), PWM_SETTING(9956063), PWM_SETTING(10548082), PWM_SETTING(11175303), PWM_SETTING(11839822), PWM_SETTING(12543854), // C9-G9
+};
+
+// Achieved frequency in microhertz for a prescaler/reload product
+static uint64_t pwmMicroHz(uint32_t ticks) {
+    return (TIM_CLK * 1000000 + ticks / 2) / ticks;
+}
 
-    // Reset counter
-    TIM16->TIM16_CNT = 0;
+PWM_Setting pwmSearch(uint32_t freq_mhz) {
+    PWM_Setting best = {0, 0};
+    uint64_t best_err = ~0ULL;
+    uint64_t target = (uint64_t) freq_mhz * 1000;
 
-    if (freq > 0) {
-        // Compute ARR (PSC=0)
-        uint32_t ARR_Val = ((5000000 * 2) / freq) - 1;
+    if (freq_mhz == 0) return best;
 
-        // Update ARR and CCR1
-        TIM16->TIM16_ARR  = ARR_Val;
-        TIM16->TIM16_CCR1 = ARR_Val / 2;   // 50% duty
+    // Smallest prescaler (PSC + 1) that keeps ARR within 16 bits
+    uint32_t div_min = (uint32_t) ((TIM_CLK * 1000 + freq_mhz * 65536ULL - 1) / (freq_mhz * 65536ULL));
+    if (div_min == 0) div_min = 1;
 
-        // Force update and start counter
-        TIM16->TIM16_EGR |= 1;
-        TIM16->TIM16_CR1 |= 1;
-    } else {
-        // Stop PWM output → 0% duty
+    for (uint32_t div = div_min; div < div_min + PWM_SEARCH_SPAN && div <= 65536; div++) {
+        // Rounded reload count for this prescaler
+        uint32_t count = (uint32_t) ((TIM_CLK * 1000 * 2 / ((uint64_t) freq_mhz * div) + 1) / 2);
+        if (count < 2 || count > 65536) continue;
+
+        uint64_t achieved = pwmMicroHz(div * count);
+        uint64_t err = (achieved > target) ? achieved - target : target - achieved;
+
+        // Ties keep the smaller prescaler, which has the finer duty resolution
+        if (err < best_err) {
+            best_err = err;
+            best.psc = div - 1;
+            best.arr = count - 1;
+            if (err == 0) break;
+        }
+    }
+    return best;
+}
+
+void setTIM16_pwm(PWM_Setting setting) {
+    if (setting.arr == 0) {
+        // Rest: keep the pitch running, the output stays low from the next period
         TIM16->TIM16_CCR1 = 0;
+        if (!(TIM16->TIM16_CR1 & 1)) TIM16->TIM16_EGR |= 1;
+        return;
+    }
+
+    uint32_t ccr = (setting.arr + 1) / 2; // 50% duty
+
+    if (!(TIM16->TIM16_CR1 & 1)) {
+        // First note: load the registers directly and start the counter
+        TIM16->TIM16_PSC  = setting.psc;
+        TIM16->TIM16_ARR  = setting.arr;
+        TIM16->TIM16_CCR1 = ccr;
         TIM16->TIM16_EGR |= 1;
         TIM16->TIM16_CR1 |= 1;
+        return;
+    }
+
+    // PSC, ARR (ARPE) and CCR1 (OC1PE) are preloaded and only move to the shadow
+    // registers at an update event. UDIS holds the update event off while they're
+    // written, so the current period finishes at the old pitch and the new one
+    // starts whole, with no counter reset and no click.
+    TIM16->TIM16_CR1 |= (1 << 1);  // UDIS
+    TIM16->TIM16_PSC  = setting.psc;
+    TIM16->TIM16_ARR  = setting.arr;
+    TIM16->TIM16_CCR1 = ccr;
+    TIM16->TIM16_CR1 &= ~(1 << 1);
+}
+
+void setTIM16_freq(uint32_t freq) {
+    setTIM16_pwm(pwmSearch(freq * 1000));
+}
+
+void setTIM16_note(int midi) {
+    PWM_Setting rest = {0, 0};
+
+    if (midi < NOTE_MIDI_MIN || midi > NOTE_MIDI_MAX) {
+        setTIM16_pwm(rest);
+    } else {
+        setTIM16_pwm(noteTable[midi - NOTE_MIDI_MIN]);
     }
 }
@@ -81,13 +81,51 @@ typedef struct
 
 #define TIM16 ((TIM16_TypeDef *) TIM16_BASE)
 
+// NVIC set-enable register for IRQs 0-31
+#define NVIC_ISER0 (*(__IO uint32_t *) 0xE000E100UL)
+#define TIM1_BRK_TIM15_IRQn 24
+
+// Timer kernel clock: PCLK2 = 5 MHz, doubled because the APB2 prescaler isn't 1
+#define TIM_CLK 10000000ULL
+
+// Prescaler/auto-reload pair for one PWM frequency
+typedef struct {
+  uint16_t psc;
+  uint16_t arr;
+} PWM_Setting;
+
+// Compile-time PSC/ARR for a frequency in millihertz: the smallest prescaler
+// that fits ARR in 16 bits (finest frequency and duty resolution), with ARR rounded
+#define PWM_PSC(mhz) ((TIM_CLK * 1000 + (mhz) * 65536ULL - 1) / ((mhz) * 65536ULL) - 1)
+#define PWM_ARR(mhz) ((TIM_CLK * 1000 * 2 / ((mhz) * (PWM_PSC(mhz) + 1)) + 1) / 2 - 1)
+#define PWM_SETTING(mhz) {PWM_PSC(mhz), PWM_ARR(mhz)}
+
+// Equal-tempered note table range (MIDI note numbers, A4 = 69 = 440 Hz).
+// MIDI stops at 127, so pitches from G9 up to the 20 kHz edge of hearing have
+// no note number: play them with setTIM16_freq(), whose pwmSearch() covers any
+// frequency the timer can make.
+#define NOTE_MIDI_MIN 16  // E0, 20.6 Hz
+#define NOTE_MIDI_MAX 127 // G9, 12.5 kHz
+
+#define PWM_SEARCH_SPAN 256 // Prescalers tried by pwmSearch() above the smallest one that fits
+
+extern const PWM_Setting noteTable[NOTE_MIDI_MAX - NOTE_MIDI_MIN + 1];
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
 
 void initTIM15(void);
 void initTIM16(void);
-void setTIM16_freq(uint32_t freq);
+void setTIM16_freq(uint32_t freq);         // Hz, 0 for a rest; any audible pitch, including above noteTable
+void setTIM16_pwm(PWM_Setting setting);    // Glitch-free: takes effect at the next update event
+void setTIM16_note(int midi);              // Plays noteTable[midi]
+PWM_Setting pwmSearch(uint32_t freq_mhz);  // PSC/ARR with the least frequency error
 void DelayTIM15(uint32_t ms);             // calculated off of TIM15
 
+// Turns on the TIM15 update interrupt: tim15Millis counts ms, the hook (if any)
+// runs every ms from the ISR, and DelayTIM15() waits on the count instead of UIF
+void enableTIM15Tick(void (*hook)(void));
+extern volatile uint32_t tim15Millis;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+// STM32L432KC_USART.c
+// Source code for USART functions
+
+#include "STM32L432KC_USART.h"
+#include "STM32L432KC_GPIO.h"
+#include "STM32L432KC_RCC.h"
+
+USART_TypeDef * id2Port(int USART_ID) {
+    USART_TypeDef * USART;
+    switch(USART_ID){
+        case(USART1_ID) :
+            USART = USART1;
+            break;
+        case(USART2_ID) :
+            USART = USART2;
+            break;
+        default :
+            USART = 0;
+    }
+    return USART;
+}
+
+// Puts a port A pin on an alternate function
+static void usartPin(int pin, int af) {
+    pinMode(pin, GPIO_ALT);
+    if (pin < 8) {
+        GPIO->AFRL &= ~(0b1111 << 4*pin);
+        GPIO->AFRL |=  (af << 4*pin);
+    } else {
+        GPIO->AFRH &= ~(0b1111 << 4*(pin-8));
+        GPIO->AFRH |=  (af << 4*(pin-8));
+    }
+}
+
+USART_TypeDef * initUSART(int USART_ID, int baud_rate) {
+    USART_TypeDef * USART = id2Port(USART_ID); // Get pointer to USART
+
+    RCC->CR |= (1 << 8);          // Turn on HSI 16 MHz clock
+    while (!(RCC->CR & (1 << 10))); // Wait for HSIRDY
+    RCC->AHB2ENR |= (0b1);        // GPIO port A
+
+    switch(USART_ID){
+        case USART1_ID :
+            RCC->APB2ENR |= (1 << 14);    // USART1EN
+            RCC->CCIPR &= ~(0b11 << 0);
+            RCC->CCIPR |=  (0b10 << 0);   // USART1SEL = HSI16
+            usartPin(9, 7);               // PA9 TX, AF7
+            usartPin(10, 7);              // PA10 RX, AF7
+            break;
+        case USART2_ID :
+            RCC->APB1ENR1 |= (1 << 17);   // USART2EN
+            RCC->CCIPR &= ~(0b11 << 2);
+            RCC->CCIPR |=  (0b10 << 2);   // USART2SEL = HSI16
+            usartPin(2, 7);               // PA2 TX, AF7
+            usartPin(15, 3);              // PA15 RX, AF3
+            break;
+    }
+
+    USART->CR1 &= ~1;                          // UE = 0 while configuring
+    USART->CR1 &= ~((1 << 28) | (1 << 12));    // M = 00: 8 data bits
+    USART->CR1 &= ~(1 << 15);                  // OVER8 = 0: 16x oversampling
+    USART->CR2 &= ~(0b11 << 12);               // 1 stop bit
+
+    // Tx/Rx baud = f_CK/USARTDIV with 16x oversampling
+    USART->BRR = (uint16_t) (USART_CLK / baud_rate);
+
+    USART->CR1 |= 1;                           // UE
+    USART->CR1 |= (1 << 3) | (1 << 2);         // TE, RE
+
+    return USART;
+}
+
+void sendChar(USART_TypeDef * USART, char data){
+    while(!(USART->ISR & USART_ISR_TXE));
+    USART->TDR = data;
+    while(!(USART->ISR & USART_ISR_TC));
+}
+
+void sendString(USART_TypeDef * USART, char * charArray){
+
+    uint32_t i = 0;
+    do{
+        sendChar(USART, charArray[i]);
+        i++;
+    }
+    while(charArray[i] != 0);
+}
+
+char readChar(USART_TypeDef * USART) {
+        char data = USART->RDR;
+        return data;
+}
+
+volatile uint32_t usartOverruns = 0;
+static void (*usartHook[3])(char data);
+
+void usartOnReceive(USART_TypeDef * USART, void (*hook)(char data)) {
+    int id = (USART == USART1) ? USART1_ID : USART2_ID;
+
+    usartHook[id] = hook;
+    USART->ICR = USART_ISR_ORE;   // ORECF
+    USART->CR1 |= (1 << 5);       // RXNEIE, also raised by ORE
+    NVIC_ISER1 = (1UL << ((id == USART1_ID ? USART1_IRQn : USART2_IRQn) - 32));
+}
+
+static void usartIRQ(USART_TypeDef * USART, int id) {
+    uint32_t isr = USART->ISR;
+
+    // An overrun keeps the interrupt pending until ORE is cleared
+    if (isr & USART_ISR_ORE) {
+        USART->ICR = USART_ISR_ORE;
+        usartOverruns++;
+    }
+    if (isr & USART_ISR_RXNE) {
+        char data = readChar(USART);  // Reading RDR clears RXNE
+        if (usartHook[id]) usartHook[id](data);
+    }
+}
+
+void USART1_IRQHandler(void) {
+    usartIRQ(USART1, USART1_ID);
+}
+
+void USART2_IRQHandler(void) {
+    usartIRQ(USART2, USART2_ID);
+}
@@ -0,0 +1,75 @@
+// STM32L432KC_USART.h
+// Header for USART functions
+
+#ifndef STM32L4_USART_H
+#define STM32L4_USART_H
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+#define __IO volatile
+
+// Base addresses
+#define USART1_BASE (0x40013800UL)
+#define USART2_BASE (0x40004400UL)
+
+// Defines for USART case statements
+#define USART1_ID   1
+#define USART2_ID   2 // PA2 TX / PA15 RX, the Nucleo's ST-LINK virtual COM port
+
+// Kernel clock: HSI16, so the baud rate doesn't depend on the PLL/prescaler setup
+#define USART_CLK 16000000UL
+
+// ISR bits
+#define USART_ISR_ORE  (1 << 3)
+#define USART_ISR_RXNE (1 << 5)
+#define USART_ISR_TC   (1 << 6)
+#define USART_ISR_TXE  (1 << 7)
+
+// NVIC set-enable register for IRQs 32-63
+#define NVIC_ISER1 (*(__IO uint32_t *) 0xE000E104UL)
+#define USART1_IRQn 37
+#define USART2_IRQn 38
+
+/**
+  * @brief Universal Synchronous Asynchronous Receiver Transmitter
+  */
+
+typedef struct
+{
+  __IO uint32_t CR1;  /*!< USART control register 1,                 Address offset: 0x00 */
+  __IO uint32_t CR2;  /*!< USART control register 2,                 Address offset: 0x04 */
+  __IO uint32_t CR3;  /*!< USART control register 3,                 Address offset: 0x08 */
+  __IO uint32_t BRR;  /*!< USART baud rate register,                 Address offset: 0x0C */
+  __IO uint32_t GTPR; /*!< USART guard time and prescaler register,  Address offset: 0x10 */
+  __IO uint32_t RTOR; /*!< USART receiver timeout register,          Address offset: 0x14 */
+  __IO uint32_t RQR;  /*!< USART request register,                   Address offset: 0x18 */
+  __IO uint32_t ISR;  /*!< USART interrupt and status register,      Address offset: 0x1C */
+  __IO uint32_t ICR;  /*!< USART interrupt flag clear register,      Address offset: 0x20 */
+  __IO uint32_t RDR;  /*!< USART receive data register,              Address offset: 0x24 */
+  __IO uint32_t TDR;  /*!< USART transmit data register,             Address offset: 0x28 */
+} USART_TypeDef;
+
+#define USART1 ((USART_TypeDef *) USART1_BASE)
+#define USART2 ((USART_TypeDef *) USART2_BASE)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+USART_TypeDef * id2Port(int USART_ID);
+// Also sets up the TX/RX pins (PA9/PA10 for USART1, PA2/PA15 for USART2)
+USART_TypeDef * initUSART(int USART_ID, int baud_rate);
+void sendChar(USART_TypeDef * USART, char data);
+char readChar(USART_TypeDef * USART);
+void sendString(USART_TypeDef * USART, char * charArray);
+
+// Turns on the RX interrupt: hook gets each byte as it arrives, from the ISR.
+// Overruns are cleared there and counted in usartOverruns.
+void usartOnReceive(USART_TypeDef * USART, void (*hook)(char data));
+extern volatile uint32_t usartOverruns;
+
+#endif
@@ -10,163 +10,73 @@
 
 #include "STM32L432KC_TIM.h"
 
+#include "seq.h"
+
+#include "stream.h"
+
+#include "synth.h"
+
 #include "stdint.h"
 
 #include <stdio.h>
 
-int mario[][2] = {
-  {660,100}, {660,100}, {0,100}, {660,100}, 
-  {0,150}, {523,100}, {660,100}, {0,150}, {784,100}, 
-  {0,300}, {392,100}, {0,300}, 
+#define SYNTH_PLAYER 0 // 1: polyphonic synth on TIM16, 0: one square-wave voice
+#define SYNTH_BENCH 0  // 1: print synthBenchmark() figures at startup (see synth.h)
+#define STREAM_PLAYER 0 // 1: play songs sent over USART2 by tools/streamsong.py
 
-  {523,100}, {0,250}, {392,100}, {0,250}, {330,100}, 
-  {0,250}, {440,100}, {494,100}, {466,100}, {440,100}, 
-  {392,100}, {660,100}, {784,100}, {880,100}, {698,100}, {784,100}, 
-  {660,100}, {523,100}, {587,100}, {494,100}, {0,300}, 
+// Packed songs (seq.h): tick length in ms, then SEQ_EVENT(MIDI note, ticks), 0 = rest
+const uint16_t mario[] = {
+  50,
+  SEQ_EVENT(76, 2), SEQ_EVENT(76, 2), SEQ_EVENT(0, 2), SEQ_EVENT(76, 2),
+  SEQ_EVENT(0, 3), SEQ_EVENT(72, 2), SEQ_EVENT(76, 2), SEQ_EVENT(0, 3), SEQ_EVENT(79, 2),
+  SEQ_EVENT(0, 6), SEQ_EVENT(67, 2), SEQ_EVENT(0, 6),
+
+  SEQ_EVENT(72, 2), SEQ_EVENT(0, 5), SEQ_EVENT(67, 2), SEQ_EVENT(0, 5), SEQ_EVENT(64, 2),
+  SEQ_EVENT(0, 5), SEQ_EVENT(69, 2), SEQ_EVENT(71, 2), SEQ_EVENT(70, 2), SEQ_EVENT(69, 2),
+  SEQ_EVENT(67, 2), SEQ_EVENT(76, 2), SEQ_EVENT(79, 2), SEQ_EVENT(81, 2), SEQ_EVENT(77, 2), SEQ_EVENT(79, 2),
+  SEQ_EVENT(76, 2), SEQ_EVENT(72, 2), SEQ_EVENT(74, 2), SEQ_EVENT(71, 2), SEQ_EVENT(0, 6),
 
   // second phrase
-  {523,100}, {0,150}, {392,100}, {0,150}, {330,100}, 
-  {0,150}, {440,100}, {494,100}, {466,100}, {440,100}, 
-  {392,100}, {660,100}, {784,100}, {880,100}, 
-  {698,100}, {784,100}, {660,100}, {523,100}, {587,100}, {494,100}, 
-  {0,300}, 
+  SEQ_EVENT(72, 2), SEQ_EVENT(0, 3), SEQ_EVENT(67, 2), SEQ_EVENT(0, 3), SEQ_EVENT(64, 2),
+  SEQ_EVENT(0, 3), SEQ_EVENT(69, 2), SEQ_EVENT(71, 2), SEQ_EVENT(70, 2), SEQ_EVENT(69, 2),
+  SEQ_EVENT(67, 2), SEQ_EVENT(76, 2), SEQ_EVENT(79, 2), SEQ_EVENT(81, 2),
+  SEQ_EVENT(77, 2), SEQ_EVENT(79, 2), SEQ_EVENT(76, 2), SEQ_EVENT(72, 2), SEQ_EVENT(74, 2), SEQ_EVENT(71, 2),
+  SEQ_EVENT(0, 6),
 
   // rising sequence
-  {784,100}, {740,100}, {698,100}, {622,100}, {659,100}, 
-  {415,100}, {440,100}, {523,100}, {0,200}, {440,100}, {523,100}, 
-  {587,100}, {0,150}, {494,100}, {523,100}, {440,100}, {0,200}, 
-
-  {784,100}, {740,100}, {698,100}, {622,100}, {659,100}, 
-  {415,100}, {440,100}, {523,100}, {0,200}, {440,100}, {523,100}, 
-  {587,100}, {0,150}, {494,100}, {523,100}, {440,100}, {0,300}
+  SEQ_EVENT(79, 2), SEQ_EVENT(78, 2), SEQ_EVENT(77, 2), SEQ_EVENT(75, 2), SEQ_EVENT(76, 2),
+  SEQ_EVENT(68, 2), SEQ_EVENT(69, 2), SEQ_EVENT(72, 2), SEQ_EVENT(0, 4), SEQ_EVENT(69, 2), SEQ_EVENT(72, 2),
+  SEQ_EVENT(74, 2), SEQ_EVENT(0, 3), SEQ_EVENT(71, 2), SEQ_EVENT(72, 2), SEQ_EVENT(69, 2), SEQ_EVENT(0, 4),
+
+  SEQ_EVENT(79, 2), SEQ_EVENT(78, 2), SEQ_EVENT(77, 2), SEQ_EVENT(75, 2), SEQ_EVENT(76, 2),
+  SEQ_EVENT(68, 2), SEQ_EVENT(69, 2), SEQ_EVENT(72, 2), SEQ_EVENT(0, 4), SEQ_EVENT(69, 2), SEQ_EVENT(72, 2),
+  SEQ_EVENT(74, 2), SEQ_EVENT(0, 3), SEQ_EVENT(71, 2), SEQ_EVENT(72, 2), SEQ_EVENT(69, 2), SEQ_EVENT(0, 6),
+  SEQ_END
 };
 
-
-
-
-
-// Pitch in Hz, duration in ms
-const int notes[][2] = {
-{659,	125},
-{623,	125},
-{659,	125},
-{623,	125},
-{659,	125},
-{494,	125},
-{587,	125},
-{523,	125},
-{440,	250},
-{  0,	125},
-{262,	125},
-{330,	125},
-{440,	125},
-{494,	250},
-{  0,	125},
-{330,	125},
-{416,	125},
-{494,	125},
-{523,	250},
-{  0,	125},
-{330,	125},
-{659,	125},
-{623,	125},
-{659,	125},
-{623,	125},
-{659,	125},
-{494,	125},
-{587,	125},
-{523,	125},
-{440,	250},
-{  0,	125},
-{262,	125},
-{330,	125},
-{440,	125},
-{494,	250},
-{  0,	125},
-{330,	125},
-{523,	125},
-{494,	125},
-{440,	250},
-{  0,	125},
-{494,	125},
-{523,	125},
-{587,	125},
-{659,	375},
-{392,	125},
-{699,	125},
-{659,	125},
-{587,	375},
-{349,	125},
-{659,	125},
-{587,	125},
-{523,	375},
-{330,	125},
-{587,	125},
-{523,	125},
-{494,	250},
-{  0,	125},
-{330,	125},
-{659,	125},
-{  0,	250},
-{659,	125},
-{1319,	125},
-{  0,	250},
-{623,	125},
-{659,	125},
-{  0,	250},
-{623,	125},
-{659,	125},
-{623,	125},
-{659,	125},
-{623,	125},
-{659,	125},
-{494,	125},
-{587,	125},
-{523,	125},
-{440,	250},
-{  0,	125},
-{262,	125},
-{330,	125},
-{440,	125},
-{494,	250},
-{  0,	125},
-{330,	125},
-{416,	125},
-{494,	125},
-{523,	250},
-{  0,	125},
-{330,	125},
-{659,	125},
-{623,	125},
-{659,	125},
-{623,	125},
-{659,	125},
-{494,	125},
-{587,	125},
-{523,	125},
-{440,	250},
-{  0,	125},
-{262,	125},
-{330,	125},
-{440,	125},
-{494,	250},
-{  0,	125},
-{330,	125},
-{523,	125},
-{494,	125},
-{440,	500},
-{  0,	0}};
-
-void song(const int songArray[][2]){
-    int i = 0;
-
-    while (!((songArray[i][1]==0)&(songArray[i][0]==0))){
-        setTIM16_freq(songArray[i][0]);                 // turn on PWM at given frequency "freq"
-        DelayTIM15(songArray[i][1]);          // leave the note on for time "milliseconds"
-        i++;
-    }
-    setTIM16_freq(0);                  // turn off PWM and TIM2 by passing in freq=0
-}
+// Fur Elise
+const uint16_t notes[] = {
+  125,
+  SEQ_EVENT(76, 1), SEQ_EVENT(75, 1), SEQ_EVENT(76, 1), SEQ_EVENT(75, 1), SEQ_EVENT(76, 1), SEQ_EVENT(71, 1),
+  SEQ_EVENT(74, 1), SEQ_EVENT(72, 1), SEQ_EVENT(69, 2), SEQ_EVENT(0, 1), SEQ_EVENT(60, 1), SEQ_EVENT(64, 1),
+  SEQ_EVENT(69, 1), SEQ_EVENT(71, 2), SEQ_EVENT(0, 1), SEQ_EVENT(64, 1), SEQ_EVENT(68, 1), SEQ_EVENT(71, 1),
+  SEQ_EVENT(72, 2), SEQ_EVENT(0, 1), SEQ_EVENT(64, 1), SEQ_EVENT(76, 1), SEQ_EVENT(75, 1), SEQ_EVENT(76, 1),
+  SEQ_EVENT(75, 1), SEQ_EVENT(76, 1), SEQ_EVENT(71, 1), SEQ_EVENT(74, 1), SEQ_EVENT(72, 1), SEQ_EVENT(69, 2),
+  SEQ_EVENT(0, 1), SEQ_EVENT(60, 1), SEQ_EVENT(64, 1), SEQ_EVENT(69, 1), SEQ_EVENT(71, 2), SEQ_EVENT(0, 1),
+  SEQ_EVENT(64, 1), SEQ_EVENT(72, 1), SEQ_EVENT(71, 1), SEQ_EVENT(69, 2), SEQ_EVENT(0, 1), SEQ_EVENT(71, 1),
+  SEQ_EVENT(72, 1), SEQ_EVENT(74, 1), SEQ_EVENT(76, 3), SEQ_EVENT(67, 1), SEQ_EVENT(77, 1), SEQ_EVENT(76, 1),
+  SEQ_EVENT(74, 3), SEQ_EVENT(65, 1), SEQ_EVENT(76, 1), SEQ_EVENT(74, 1), SEQ_EVENT(72, 3), SEQ_EVENT(64, 1),
+  SEQ_EVENT(74, 1), SEQ_EVENT(72, 1), SEQ_EVENT(71, 2), SEQ_EVENT(0, 1), SEQ_EVENT(64, 1), SEQ_EVENT(76, 1),
+  SEQ_EVENT(0, 2), SEQ_EVENT(76, 1), SEQ_EVENT(88, 1), SEQ_EVENT(0, 2), SEQ_EVENT(75, 1), SEQ_EVENT(76, 1),
+  SEQ_EVENT(0, 2), SEQ_EVENT(75, 1), SEQ_EVENT(76, 1), SEQ_EVENT(75, 1), SEQ_EVENT(76, 1), SEQ_EVENT(75, 1),
+  SEQ_EVENT(76, 1), SEQ_EVENT(71, 1), SEQ_EVENT(74, 1), SEQ_EVENT(72, 1), SEQ_EVENT(69, 2), SEQ_EVENT(0, 1),
+  SEQ_EVENT(60, 1), SEQ_EVENT(64, 1), SEQ_EVENT(69, 1), SEQ_EVENT(71, 2), SEQ_EVENT(0, 1), SEQ_EVENT(64, 1),
+  SEQ_EVENT(68, 1), SEQ_EVENT(71, 1), SEQ_EVENT(72, 2), SEQ_EVENT(0, 1), SEQ_EVENT(64, 1), SEQ_EVENT(76, 1),
+  SEQ_EVENT(75, 1), SEQ_EVENT(76, 1), SEQ_EVENT(75, 1), SEQ_EVENT(76, 1), SEQ_EVENT(71, 1), SEQ_EVENT(74, 1),
+  SEQ_EVENT(72, 1), SEQ_EVENT(69, 2), SEQ_EVENT(0, 1), SEQ_EVENT(60, 1), SEQ_EVENT(64, 1), SEQ_EVENT(69, 1),
+  SEQ_EVENT(71, 2), SEQ_EVENT(0, 1), SEQ_EVENT(64, 1), SEQ_EVENT(72, 1), SEQ_EVENT(71, 1), SEQ_EVENT(69, 4),
+  SEQ_END
+};
 
 void testDelay(){
   while(1){
@@ -186,12 +96,33 @@ int main(void) {
     initTIM16();
     PA6OutputPWM();
 
-    song(notes);
-    song(mario);
-	
-}
-
-
-
-
+#if SYNTH_BENCH
+    // Render cost at this clock, before any voice plays
+    synthBenchmark();
+#endif
+
+#if SYNTH_PLAYER
+    const ADSR env = {5, 60, 20000, 150}; // attack, decay, sustain (Q15), release
+    initSynth(&env, SYNTH_RATE);
+    synthStartPWM();
+    initSequencer(SEQ_OUTPUT_SYNTH);
+#else
+    initSequencer(SEQ_OUTPUT_PWM);
+#endif
+
+#if STREAM_PLAYER
+    // One song after another from the host, no reflashing
+    USART_TypeDef * USART = initUSART(USART2_ID, STREAM_BAUD);
+    while (1) {
+        streamStart(USART);
+        while (streamReceiving() || seqPlaying());
+        printf("Stream done, %lu underruns\n", (unsigned long) streamUnderruns());
+    }
+#else
+    // Both songs play from the TIM15 tick, the main loop is free
+    seqPlay(notes);
+    seqQueue(mario);
 
+    while (seqPlaying());
+#endif
+}
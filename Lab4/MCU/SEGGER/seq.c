@@ -0,0 +1,240 @@
+// seq.c
+// Interrupt-driven note sequencer: plays packed songs from the TIM15 1 ms tick
+
+#include <stdint.h>
+#include <cmsis_gcc.h> // __get_PRIMASK, __disable_irq
+#include "seq.h"
+#include "synth.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Sequencer state, owned by the tick ISR once a song is loaded
+///////////////////////////////////////////////////////////////////////////////
+
+static int output;
+
+static const uint16_t * volatile song; // Next event, 0 when idle
+static uint32_t tickLen;               // Song tick, 1/100 ms
+static uint32_t length;                // Current event, 1/100 ms
+static uint32_t elapsed;               // Into the current event, 1/100 ms at 100% tempo
+static int note;                       // Current note before transpose, SEQ_REST for a rest
+static int voice = -1;                 // Synth note handle of the current note
+static int paused;
+static SeqSource source;               // Streamed song, 0 for a song in flash
+static int stalled;                    // Waiting on source for the next block
+
+static volatile int tempo = 100;
+static volatile int transpose = 0;
+
+static const uint16_t * queue[SEQ_QUEUE];
+static int queueHead, queueCount;
+
+// API calls run with the tick held off, so the ISR never sees half an update
+static uint32_t seqLock(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void seqUnlock(uint32_t primask) {
+    __set_PRIMASK(primask);
+}
+
+static void noteStop(void) {
+    if (output == SEQ_OUTPUT_SYNTH) {
+        synthNoteOff(voice);
+        voice = -1;
+    } else {
+        setTIM16_note(SEQ_REST);
+    }
+}
+
+static void noteStart(int midi) {
+    int shifted = (midi == SEQ_REST) ? SEQ_REST : midi + transpose;
+
+    if (output == SEQ_OUTPUT_SYNTH) {
+        // Release the old note so its tail overlaps the new one
+        synthNoteOff(voice);
+        voice = (shifted == SEQ_REST) ? -1 : synthNoteOnMidi(shifted, SYNTH_LEVEL);
+    } else {
+        // Out-of-table notes (including SEQ_REST) play as a rest
+        setTIM16_note(shifted);
+    }
+}
+
+static void songLoad(const uint16_t * next) {
+    song = next;
+    if (song) {
+        tickLen = (uint32_t) *song++ * 100;
+    }
+}
+
+// Moves to the event that covers the current position, skipping events that
+// are already over and rolling into queued songs at SEQ_END
+static void seqAdvance(void) {
+    while (song) {
+        uint16_t event = *song;
+
+        if (event == SEQ_END && source) {
+            const uint16_t * block = source();
+            if (!block) {
+                // Underrun: rest until the block arrives, then carry on from there
+                if (!stalled) {
+                    noteStop();
+                    note = SEQ_REST;
+                    stalled = 1;
+                }
+                return;
+            }
+            stalled = 0;
+            if (*block != SEQ_END) {
+                song = block;
+                continue;
+            }
+            source = 0;
+        }
+
+        if (event == SEQ_END) {
+            noteStop();
+            note = SEQ_REST;
+            const uint16_t * next = 0;
+            if (queueCount) {
+                next = queue[queueHead];
+                queueHead = (queueHead + 1) % SEQ_QUEUE;
+                queueCount--;
+            }
+            songLoad(next);
+            continue;
+        }
+
+        song++;
+        length = SEQ_TICKS(event) * tickLen;
+        if (elapsed < length) {
+            note = SEQ_NOTE(event);
+            noteStart(note);
+            return;
+        }
+        elapsed -= length;
+    }
+    elapsed = 0;
+}
+
+// TIM15 tick hook, every ms. Counting in 1/100 ms steps of the tempo keeps
+// the leftover of each event, so durations don't drift at odd tempos.
+static void seqTick(void) {
+    if (!song || paused) return;
+
+    if (stalled) {
+        elapsed = 0;
+        seqAdvance();
+        return;
+    }
+
+    elapsed += tempo;
+    if (elapsed >= length) {
+        elapsed -= length;
+        seqAdvance();
+    }
+}
+
+void initSequencer(int out) {
+    output = out;
+    seqStop();
+    enableTIM15Tick(seqTick);
+}
+
+void seqPlay(const uint16_t * s) {
+    uint32_t primask = seqLock();
+    noteStop();
+    queueCount = 0;
+    paused = 0;
+    elapsed = 0;
+    stalled = 0;
+    source = 0;
+    songLoad(s);
+    seqAdvance();
+    seqUnlock(primask);
+}
+
+void seqPlayStream(SeqSource src, uint16_t tick_ms) {
+    // An empty block: the first seqAdvance() goes straight to the source
+    static const uint16_t start = SEQ_END;
+
+    uint32_t primask = seqLock();
+    noteStop();
+    queueCount = 0;
+    paused = 0;
+    elapsed = 0;
+    stalled = 0;
+    source = src;
+    tickLen = (uint32_t) tick_ms * 100;
+    song = &start;
+    seqAdvance();
+    seqUnlock(primask);
+}
+
+int seqQueue(const uint16_t * s) {
+    int ret = 0;
+    uint32_t primask = seqLock();
+
+    if (!song) {
+        elapsed = 0;
+        songLoad(s);
+        seqAdvance();
+    } else if (queueCount < SEQ_QUEUE) {
+        queue[(queueHead + queueCount) % SEQ_QUEUE] = s;
+        queueCount++;
+    } else {
+        ret = -1;
+    }
+
+    seqUnlock(primask);
+    return ret;
+}
+
+void seqPause(void) {
+    uint32_t primask = seqLock();
+    if (song && !paused) {
+        paused = 1;
+        noteStop();
+    }
+    seqUnlock(primask);
+}
+
+void seqResume(void) {
+    uint32_t primask = seqLock();
+    if (song && paused) {
+        paused = 0;
+        noteStart(note);
+    }
+    seqUnlock(primask);
+}
+
+void seqStop(void) {
+    uint32_t primask = seqLock();
+    song = 0;
+    source = 0;
+    stalled = 0;
+    queueCount = 0;
+    paused = 0;
+    note = SEQ_REST;
+    noteStop();
+    seqUnlock(primask);
+}
+
+int seqSetTempo(int percent) {
+    if (percent < SEQ_TEMPO_MIN) percent = SEQ_TEMPO_MIN;
+    if (percent > SEQ_TEMPO_MAX) percent = SEQ_TEMPO_MAX;
+    tempo = percent;
+    return percent;
+}
+
+int seqSetTranspose(int semitones) {
+    if (semitones < -SEQ_TRANSPOSE_MAX) semitones = -SEQ_TRANSPOSE_MAX;
+    if (semitones >  SEQ_TRANSPOSE_MAX) semitones =  SEQ_TRANSPOSE_MAX;
+    transpose = semitones;
+    return semitones;
+}
+
+int seqPlaying(void) {
+    return song != 0;
+}
@@ -0,0 +1,86 @@
+// seq.h
+// Header for the interrupt-driven note sequencer
+
+#ifndef SEQ_H
+#define SEQ_H
+
+#include <stdint.h>
+#include "STM32L432KC_TIM.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// A song is a flash-resident uint16_t stream:
+//   word 0:   tick length in ms
+//   word 1..: events, SEQ_EVENT(midi, ticks), midi 0 = rest
+//   last:     SEQ_END
+// Each event is 2 bytes: MIDI note in bits 15:9, duration in ticks in bits 8:0.
+#define SEQ_TICK_BITS 9
+#define SEQ_TICKS_MAX ((1 << SEQ_TICK_BITS) - 1)
+#define SEQ_EVENT(midi, ticks) ((uint16_t) (((midi) << SEQ_TICK_BITS) | (ticks)))
+#define SEQ_NOTE(event)  ((event) >> SEQ_TICK_BITS)
+#define SEQ_TICKS(event) ((event) & SEQ_TICKS_MAX)
+#define SEQ_REST 0
+#define SEQ_END  0x0000
+
+#define SEQ_QUEUE 4 // Songs waiting behind the current one
+
+// Where notes go
+#define SEQ_OUTPUT_PWM   0 // One square wave, setTIM16_note()
+#define SEQ_OUTPUT_SYNTH 1 // synthNoteOnMidi(), needs initSynth() and synthStartPWM()
+
+// Tempo in percent of the song's own tick length
+#define SEQ_TEMPO_MIN 25
+#define SEQ_TEMPO_MAX 400
+
+#define SEQ_TRANSPOSE_MAX 48 // Semitones either way
+
+// Supplies a streamed song one block at a time, from the tick ISR. Returns the
+// next block of events ending in SEQ_END, 0 if it isn't ready yet (the output
+// rests and the sequencer asks again every tick), or a block that starts with
+// SEQ_END to end the song. The previous block is done with once it's called.
+typedef const uint16_t * (*SeqSource)(void);
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Picks the output and starts the TIM15 1 ms tick that advances the song.
+ * Needs initTIM15(), and initTIM16() for either output.
+ *    -- output: SEQ_OUTPUT_PWM or SEQ_OUTPUT_SYNTH */
+void initSequencer(int output);
+
+/* Stops whatever is playing, empties the queue and starts song. */
+void seqPlay(const uint16_t * song);
+
+/* seqPlay() for a song whose events come from source, e.g. over USART.
+ *    -- tick_ms: tick length, in place of the song's first word */
+void seqPlayStream(SeqSource source, uint16_t tick_ms);
+
+/* Plays song after the current one (now, if nothing is playing).
+ *    -- return: 0, or -1 if the queue is full */
+int seqQueue(const uint16_t * song);
+
+/* Silences the output and holds the song position. */
+void seqPause(void);
+
+/* Restarts the current note for the rest of its duration. */
+void seqResume(void);
+
+/* Silences the output, drops the current song and empties the queue. */
+void seqStop(void);
+
+/* Tempo, percent (100 = as written). Takes effect mid-note.
+ *    -- return: the tempo after clamping to SEQ_TEMPO_MIN..SEQ_TEMPO_MAX */
+int seqSetTempo(int percent);
+
+/* Transpose, semitones. Takes effect from the next note; notes moved outside
+ * the note table play as rests.
+ *    -- return: the transpose after clamping to +-SEQ_TRANSPOSE_MAX */
+int seqSetTranspose(int semitones);
+
+/* 1 while a song is loaded, paused or not. */
+int seqPlaying(void);
+
+#endif
@@ -0,0 +1,127 @@
+// stream.c
+// Plays songs streamed over USART: events fill one buffer half while the
+// sequencer plays the other, with a credit byte back to the host per free half
+
+#include <stdint.h>
+#include "stream.h"
+
+static USART_TypeDef * port;
+
+// Each half has a spare slot so a full block still ends in SEQ_END
+static uint16_t halves[2][STREAM_BLOCK + 1];
+static int ready[2];            // Received and not yet played
+
+// Receive side, USART ISR
+static int fillHalf, fillPos;
+static int header;              // Next word is the tick length
+static uint16_t streamTick;
+static int haveLow;
+static uint8_t lowByte;
+static int started;
+static int lastHalf;            // Half holding the song's SEQ_END, -1 until received
+static volatile int receiving;
+
+// Play side, TIM15 ISR (same priority as the USART ISR, so they never interleave)
+static int playHalf;            // Next half to hand to the sequencer
+static int playing;             // Half the sequencer is on, -1 for none
+static int starved;
+static volatile uint32_t underruns;
+
+static const uint16_t endBlock = SEQ_END;
+
+// SeqSource for the sequencer
+static const uint16_t * streamNext(void) {
+    if (playing >= 0) {
+        int done = playing;
+        playing = -1;
+        if (done == lastHalf) return &endBlock;
+
+        // Hand the half back to the host. TXE is always set by now (one
+        // credit per block), so this doesn't hold up the tick.
+        ready[done] = 0;
+        if (receiving) {
+            while (!(port->ISR & USART_ISR_TXE));
+            port->TDR = STREAM_CREDIT;
+        }
+    }
+
+    if (!ready[playHalf]) {
+        if (!starved) underruns++;
+        starved = 1;
+        return 0;
+    }
+    starved = 0;
+    playing = playHalf;
+    playHalf ^= 1;
+    return halves[playing];
+}
+
+// USART RX hook
+static void streamReceive(char data) {
+    if (!receiving) return;
+
+    // Events arrive little-endian
+    if (!haveLow) {
+        lowByte = (uint8_t) data;
+        haveLow = 1;
+        return;
+    }
+    haveLow = 0;
+    uint16_t word = lowByte | ((uint16_t) (uint8_t) data << 8);
+
+    if (header) {
+        header = 0;
+        streamTick = word;
+        return;
+    }
+
+    // Only if the host sent more blocks than it had credits for
+    if (ready[fillHalf]) return;
+
+    halves[fillHalf][fillPos++] = word;
+    if (word != SEQ_END && fillPos < STREAM_BLOCK) return;
+
+    // Half complete
+    halves[fillHalf][fillPos] = SEQ_END;
+    if (word == SEQ_END) {
+        lastHalf = fillHalf;
+        receiving = 0;
+    }
+    ready[fillHalf] = 1;
+    fillHalf ^= 1;
+    fillPos = 0;
+
+    if (!started) {
+        started = 1;
+        seqPlayStream(streamNext, streamTick);
+    }
+}
+
+void streamStart(USART_TypeDef * USART) {
+    seqStop();
+
+    port = USART;
+    ready[0] = ready[1] = 0;
+    fillHalf = fillPos = 0;
+    header = 1;
+    haveLow = 0;
+    started = 0;
+    lastHalf = -1;
+    playHalf = 0;
+    playing = -1;
+    starved = 0;
+    underruns = 0;
+    receiving = 1;
+
+    usartOnReceive(USART, streamReceive);
+    sendChar(USART, STREAM_CREDIT);
+    sendChar(USART, STREAM_CREDIT);
+}
+
+int streamReceiving(void) {
+    return receiving;
+}
+
+uint32_t streamUnderruns(void) {
+    return underruns;
+}
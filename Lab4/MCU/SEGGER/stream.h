@@ -0,0 +1,43 @@
+// stream.h
+// Header for playing songs streamed over USART
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include "STM32L432KC_USART.h"
+#include "seq.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Protocol (tools/streamsong.py is the host side):
+//   1. The board sends STREAM_CREDIT once for each free buffer half, twice at
+//      the start, then again every time the player finishes a half.
+//   2. The host sends the song's tick length (uint16_t, little-endian) once,
+//      then STREAM_BLOCK events (little-endian) per credit it has received.
+//   3. SEQ_END ends the song. The host stops there, the block can be short.
+// The host can never send more than the board has room for, so playback only
+// starves if the host falls behind, and each time it does is one underrun.
+#define STREAM_BLOCK  64    // Events per buffer half
+#define STREAM_CREDIT 0x11  // "Send one block" (XON)
+
+#define STREAM_BAUD 115200
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Opens a stream on an initialized USART and grants the first two blocks. The
+ * song starts on the sequencer (initSequencer() first) once the first block is
+ * in, so the second is already filling when it starts playing. */
+void streamStart(USART_TypeDef * USART);
+
+/* 1 from streamStart() until the song's SEQ_END has been received. */
+int streamReceiving(void);
+
+/* Blocks the player needed before the host had sent them. */
+uint32_t streamUnderruns(void);
+
+#endif
@@ -0,0 +1,323 @@
+// synth.c
+// Polyphonic wavetable synthesizer: phase-accumulator oscillators with ADSR
+// envelopes, mixed with the Cortex-M4 dual 16-bit SIMD instructions
+
+#include <stdio.h>
+#include <stdint.h>
+#include <cmsis_gcc.h> // Cortex-M4 SIMD intrinsics (__SMLAD, __QADD16)
+#include "synth.h"
+
+#define SYNTH_TABLE_BITS 8
+#define ENV_MAX          (1UL << 30) // Envelope full scale (Q30)
+
+#define ENV_IDLE    0
+#define ENV_ATTACK  1
+#define ENV_DECAY   2
+#define ENV_SUSTAIN 3
+#define ENV_RELEASE 4
+
+// One cycle of a sine, with the first sample repeated at the end so the
+// interpolator can always read table[i + 1]
+static const int16_t sineTable[(1 << SYNTH_TABLE_BITS) + 1] = {
+       0,    804,   1608,   2410,   3212,   4011,   4808,   5602,   6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+   12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,  18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+   23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,  27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+   30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,  32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+   32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,  32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+   30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,  27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+   23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,  18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+   12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,   6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+       0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,  -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+  -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+  -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790, -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+  -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+  -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+  -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683, -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+  -23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+  -12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,  -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+       0,
+};
+
+// Voices are only touched by the renderer (synthRender()), which applies the
+// note events the API queues at the start of each block
+typedef struct {
+    uint32_t phase;     // Table position, 8.24 fixed point
+    uint32_t step;      // Phase increment per sample
+    int32_t  env;       // Envelope level, Q30
+    int      state;     // ENV_*
+    int32_t  level;     // Peak level, Q15
+    int      note;      // Handle of the note playing
+} Voice;
+
+static Voice voices[SYNTH_VOICES];
+
+// Note event from synthNoteOn()/synthNoteOff()
+typedef struct {
+    int      on;        // 1 note on, 0 note off
+    int      note;      // Note handle
+    uint32_t step;      // Note on: phase increment per sample
+    uint16_t level;     // Note on: peak level, Q15
+} NoteEvent;
+
+// Event queue: any priority posts with interrupts off, the renderer consumes
+static NoteEvent events[SYNTH_EVENTS];
+static volatile uint32_t eventHead, eventTail;
+static int nextNote;
+
+// Output sample rate, and envelope increments per sample in Q30
+static uint32_t synthRate = SYNTH_RATE;
+static int32_t attackStep, decayStep, releaseStep, sustainLevel;
+
+// PWM output double buffer: the TIM16 ISR plays one half while PendSV renders the other
+static int16_t pwmBlock[2][SYNTH_BLOCK] __attribute__((aligned(4)));
+static volatile int pwmPlay = 0;
+static int pwmPos = 0;
+
+// Envelope change per sample for a segment lasting ms
+static int32_t envStep(uint32_t ms) {
+    uint32_t samples = (uint32_t) (((uint64_t) ms * synthRate) / 1000);
+    return (int32_t) (ENV_MAX / (samples ? samples : 1));
+}
+
+void initSynth(const ADSR * env, uint32_t rate_hz) {
+    synthRate    = rate_hz;
+    attackStep   = envStep(env->attack_ms);
+    decayStep    = envStep(env->decay_ms);
+    releaseStep  = envStep(env->release_ms);
+    sustainLevel = (int32_t) env->sustain << 15;
+
+    for (int v = 0; v < SYNTH_VOICES; v++) voices[v].state = ENV_IDLE;
+    eventTail = eventHead;
+}
+
+// Queues an event for the renderer. A note on gets a new handle.
+//    -- return: the note handle, or -1 if the queue is full
+static int eventPost(int on, int note, uint32_t step, uint16_t level) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (eventHead - eventTail == SYNTH_EVENTS) {
+        __set_PRIMASK(primask);
+        return -1;
+    }
+    if (on) {
+        note = nextNote;
+        nextNote = (nextNote + 1) & 0x7FFFFFFF;
+    }
+
+    NoteEvent * e = &events[eventHead % SYNTH_EVENTS];
+    e->on = on;
+    e->note = note;
+    e->step = step;
+    e->level = level;
+    __DMB(); // Event written before the renderer can see it
+    eventHead++;
+
+    __set_PRIMASK(primask);
+    return note;
+}
+
+static void voiceStart(int note, uint32_t step, uint16_t level) {
+    int pick = 0;
+
+    // Free voice first, otherwise the quietest one
+    for (int v = 0; v < SYNTH_VOICES; v++) {
+        if (voices[v].state == ENV_IDLE) { pick = v; break; }
+        if (voices[v].env < voices[pick].env) pick = v;
+    }
+
+    Voice * voice = &voices[pick];
+    voice->step  = step;
+    voice->phase = 0;
+    voice->level = level;
+    voice->env   = 0;
+    voice->note  = note;
+    voice->state = ENV_ATTACK;
+}
+
+// Applies the queued note events, from the renderer only
+static void eventsApply(void) {
+    while (eventTail != eventHead) {
+        NoteEvent * e = &events[eventTail % SYNTH_EVENTS];
+
+        if (e->on) {
+            voiceStart(e->note, e->step, e->level);
+        } else {
+            for (int v = 0; v < SYNTH_VOICES; v++) {
+                if (voices[v].state != ENV_IDLE && voices[v].note == e->note) voices[v].state = ENV_RELEASE;
+            }
+        }
+        __DMB(); // Event read before its slot is handed back
+        eventTail++;
+    }
+}
+
+int synthNoteOn(uint32_t freq, uint16_t level) {
+    return eventPost(1, 0, (uint32_t) (((uint64_t) freq << 32) / synthRate), level);
+}
+
+// PWM table entries are TIM_CLK / ((PSC + 1) * (ARR + 1)) Hz, so the step is
+// TIM_CLK * 2^32 / ((PSC + 1) * (ARR + 1) * rate), without rounding the pitch
+// to whole Hz
+int synthNoteOnMidi(int midi, uint16_t level) {
+    if (midi < NOTE_MIDI_MIN || midi > NOTE_MIDI_MAX) return -1;
+
+    const PWM_Setting * pwm = &noteTable[midi - NOTE_MIDI_MIN];
+    uint64_t ticks = (uint64_t) (pwm->psc + 1) * (pwm->arr + 1);
+    uint32_t step = (uint32_t) ((TIM_CLK << 32) / (ticks * synthRate));
+
+    return eventPost(1, 0, step, level);
+}
+
+void synthNoteOff(int note) {
+    if (note >= 0) eventPost(0, note, 0, 0);
+}
+
+// Advances a voice's envelope over a block of n samples
+static void envAdvance(Voice * voice, int n) {
+    int64_t env = voice->env;
+
+    switch (voice->state) {
+        case ENV_ATTACK:
+            env += (int64_t) attackStep * n;
+            if (env >= (int64_t) ENV_MAX) { env = ENV_MAX; voice->state = ENV_DECAY; }
+            break;
+        case ENV_DECAY:
+            env -= (int64_t) decayStep * n;
+            if (env <= sustainLevel) { env = sustainLevel; voice->state = ENV_SUSTAIN; }
+            break;
+        case ENV_RELEASE:
+            env -= (int64_t) releaseStep * n;
+            if (env <= 0) { env = 0; voice->state = ENV_IDLE; }
+            break;
+    }
+    voice->env = (int32_t) env;
+}
+
+// One interpolated table sample at phase, scaled by gain (Q15)
+static inline int32_t voiceSample(uint32_t phase, int32_t gain) {
+    // Neighbouring table samples as a 16-bit pair, weighted (1 - frac, frac)
+    uint32_t idx = phase >> (32 - SYNTH_TABLE_BITS);
+    uint32_t frac = (phase >> (17 - SYNTH_TABLE_BITS)) & 0x7FFF;
+    uint32_t taps = __UNALIGNED_UINT32_READ(&sineTable[idx]);
+    uint32_t weights = (32767 - frac) | (frac << 16);
+
+    // Linear interpolation in one dual multiply-accumulate (Q30 -> Q15)
+    int32_t sample = (int32_t) __SMLAD(taps, weights, 0) >> 15;
+    return (sample * gain) >> 15;
+}
+
+void synthRender(int16_t * out, int n) {
+    uint32_t * pairs = (uint32_t *) out;
+
+    eventsApply();
+    for (int i = 0; i < n / 2; i++) pairs[i] = 0;
+    if (n & 1) out[n - 1] = 0;
+
+    for (int v = 0; v < SYNTH_VOICES; v++) {
+        Voice * voice = &voices[v];
+        if (voice->state == ENV_IDLE) continue;
+
+        envAdvance(voice, n);
+
+        // Block gain: peak level x envelope, Q15
+        int32_t gain = (int32_t) (((int64_t) voice->level * voice->env) >> 30);
+        uint32_t phase = voice->phase;
+        uint32_t step = voice->step;
+
+        for (int i = 0; i < n / 2; i++) {
+            uint32_t mixed = 0;
+
+            for (int k = 0; k < 2; k++) {
+                mixed |= ((uint32_t) voiceSample(phase, gain) & 0xFFFF) << (16 * k);
+                phase += step;
+            }
+
+            // Saturating add of both samples into the mix
+            pairs[i] = __QADD16(pairs[i], mixed);
+        }
+
+        // Odd n: the last sample on its own, in the low half of a pair
+        if (n & 1) {
+            uint32_t last = (uint16_t) out[n - 1];
+            out[n - 1] = (int16_t) __QADD16(last, (uint32_t) voiceSample(phase, gain) & 0xFFFF);
+            phase += step;
+        }
+        voice->phase = phase;
+    }
+}
+
+void synthRefill(void * half, int samples, void * ctx) {
+    uint16_t * out = half;
+
+    synthRender((int16_t *) out, samples);
+    for (int i = 0; i < samples; i++) out[i] ^= 0x8000; // Signed -> offset binary
+}
+
+void synthStartPWM(void) {
+    synthRender(pwmBlock[0], SYNTH_BLOCK);
+    synthRender(pwmBlock[1], SYNTH_BLOCK);
+    pwmPlay = 0;
+    pwmPos = 0;
+
+    // PendSV renders at the lowest priority so it never delays a sample
+    SCB_SHPR3 |= (0xFFUL << 16);
+
+    // Fixed carrier, CCR1 preload (set by initTIM16) latches each sample at the update event
+    TIM16->TIM16_CR1 &= ~1;
+    TIM16->TIM16_PSC  = 0;
+    TIM16->TIM16_ARR  = SYNTH_PWM_ARR;
+    TIM16->TIM16_CCR1 = (SYNTH_PWM_ARR + 1) / 2;
+    TIM16->TIM16_EGR |= 1;
+    TIM16->TIM16_SR  &= ~1;
+    TIM16->TIM16_DIER |= 1;  // Update interrupt
+    NVIC_ISER0 = (1UL << TIM1_UP_TIM16_IRQn);
+    TIM16->TIM16_CR1 |= 1;
+}
+
+// One sample per carrier period
+void TIM1_UP_TIM16_IRQHandler(void) {
+    TIM16->TIM16_SR &= ~1;
+
+    int16_t sample = pwmBlock[pwmPlay][pwmPos];
+    TIM16->TIM16_CCR1 = (uint16_t) (sample + 32768) >> (16 - SYNTH_PWM_BITS);
+
+    if (++pwmPos == SYNTH_BLOCK) {
+        pwmPos = 0;
+        pwmPlay ^= 1;
+        SCB_ICSR = (1UL << 28); // PENDSVSET: render the half just played
+    }
+}
+
+void PendSV_Handler(void) {
+    synthRender(pwmBlock[pwmPlay ^ 1], SYNTH_BLOCK);
+}
+
+void synthBenchmark(void) {
+    int16_t block[SYNTH_BLOCK] __attribute__((aligned(4)));
+    uint32_t start, empty, full;
+
+    DEMCR |= (1UL << 24);
+    DWT_CTRL |= 1;
+
+    for (int v = 0; v < SYNTH_VOICES; v++) voices[v].state = ENV_IDLE;
+    start = DWT_CYCCNT;
+    synthRender(block, SYNTH_BLOCK);
+    empty = DWT_CYCCNT - start;
+
+    for (int v = 0; v < SYNTH_VOICES; v++) synthNoteOn(220 * (v + 1), SYNTH_LEVEL);
+    start = DWT_CYCCNT;
+    synthRender(block, SYNTH_BLOCK);
+    full = DWT_CYCCNT - start;
+
+    for (int v = 0; v < SYNTH_VOICES; v++) voices[v].state = ENV_IDLE;
+
+    // Cycles per voice per sample, in hundredths
+    uint32_t per_voice = ((full - empty) * 100) / (SYNTH_VOICES * SYNTH_BLOCK);
+    // Voices one MHz of core clock can sustain at the sample rate, in hundredths
+    uint32_t per_mhz = per_voice ? (uint32_t) (10000000000ULL / ((uint64_t) synthRate * per_voice)) : 0;
+
+    printf("synth: %lu.%02lu cycles/voice-sample, %lu cycles/block overhead, %lu.%02lu voices/MHz at %lu Hz\n",
+           (unsigned long) (per_voice / 100), (unsigned long) (per_voice % 100), (unsigned long) empty,
+           (unsigned long) (per_mhz / 100), (unsigned long) (per_mhz % 100), (unsigned long) synthRate);
+}
@@ -0,0 +1,99 @@
+// synth.h
+// Header for the polyphonic wavetable synthesizer
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+#include "STM32L432KC_TIM.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+#define SYNTH_VOICES  4   // Voices mixed per sample
+#define SYNTH_BLOCK   32  // Samples rendered per PendSV by the PWM output
+#define SYNTH_EVENTS  16  // Note ons/offs waiting for the next block
+
+// PWM output: TIM16 runs a fixed carrier and each update event loads the next
+// sample into CCR1, so the sample rate is the carrier rate
+#define SYNTH_PWM_BITS 9
+#define SYNTH_PWM_ARR  ((1 << SYNTH_PWM_BITS) - 1)
+#define SYNTH_RATE     ((uint32_t) (TIM_CLK / (SYNTH_PWM_ARR + 1))) // 19531 Hz
+
+#define SYNTH_LEVEL (32767 / SYNTH_VOICES) // Note level that can't clip with every voice on
+
+// Cortex-M4 core registers used by the PWM output path
+#define SCB_ICSR   (*(__IO uint32_t *) 0xE000ED04UL) // Bit 28: PENDSVSET
+#define SCB_SHPR3  (*(__IO uint32_t *) 0xE000ED20UL) // Bits 23:16: PendSV priority
+#define DEMCR      (*(__IO uint32_t *) 0xE000EDFCUL) // Bit 24: TRCENA
+#define DWT_CTRL   (*(__IO uint32_t *) 0xE0001000UL) // Bit 0: CYCCNTENA
+#define DWT_CYCCNT (*(__IO uint32_t *) 0xE0001004UL)
+
+#define TIM1_UP_TIM16_IRQn 25
+
+// Envelope shape shared by every voice. Times are in ms, sustain is Q15 (32767 = full level).
+typedef struct {
+    uint16_t attack_ms;
+    uint16_t decay_ms;
+    uint16_t sustain;
+    uint16_t release_ms;
+} ADSR;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Sets the envelope and output rate and silences every voice. Enough for
+ * synthRender()/synthRefill() users, which may render any number of samples
+ * per call; envelopes advance by the samples rendered.
+ *    -- rate_hz: samples per second, SYNTH_RATE for synthStartPWM() */
+void initSynth(const ADSR * env, uint32_t rate_hz);
+
+/* Starts the PWM output on TIM16 CH1 (PA6): a SYNTH_RATE carrier whose duty
+ * is the mixed sample. TIM16's update ISR plays samples from a double buffer
+ * and PendSV (lowest priority) renders the next block. Needs initTIM16() and
+ * initSynth() at SYNTH_RATE. */
+void synthStartPWM(void);
+
+/* Starts a note on a free voice, or steals the quietest voice. Note ons and
+ * offs are queued and take effect at the start of the next rendered block,
+ * so they are safe from any interrupt priority.
+ *    -- freq: Hz
+ *    -- level: peak level, Q15; SYNTH_LEVEL never clips
+ *    -- return: a note handle for synthNoteOff(), or -1 if SYNTH_EVENTS
+ *               events are already waiting */
+int synthNoteOn(uint32_t freq, uint16_t level);
+
+/* synthNoteOn() for a noteTable entry.
+ *    -- midi: NOTE_MIDI_MIN to NOTE_MIDI_MAX
+ *    -- return: a note handle, or -1 if midi is out of the table or the
+ *               queue is full */
+int synthNoteOnMidi(int midi, uint16_t level);
+
+/* Moves a note into its release phase, unless its voice was stolen since.
+ * Handles below 0 are ignored. */
+void synthNoteOff(int note);
+
+/* Applies the queued note events, then mixes all voices into n signed 16-bit
+ * samples (out 4-byte aligned; an odd n costs one unpaired sample). Runs
+ * from one context only. */
+void synthRender(int16_t * out, int n);
+
+/* Renders unsigned 16-bit samples (silence = 0x8000) in the shape of a
+ * DMA ping-pong refill callback: half, samples, ctx (unused). The rate is
+ * initSynth()'s and the block is "samples". */
+void synthRefill(void * half, int samples, void * ctx);
+
+/* Renders with every voice sounding and prints cycles per voice-sample and
+ * voices per MHz, 10^6 / (rate * cycles per voice-sample): how many voices
+ * one MHz of core clock sustains at initSynth()'s rate (SYNTH_RATE before). Voices' notes are
+ * restarted, so call it before playing (SYNTH_BENCH in main.c).
+ *
+ * Expected at 80 MHz, from the inner loop's instruction count (about 12
+ * cycles per sample plus 3-4 for the pair mix and loop), not a board run:
+ * ~15 cycles/voice-sample, ~3.3 voices/MHz, so ~260 voices of CPU at 80 MHz.
+ * Replace with the printed figure once measured. */
+void synthBenchmark(void);
+
+#endif
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+# midi2seq.py
+# Converts a Standard MIDI File into a packed song for the Lab 4 sequencer (seq.h)
+#
+# usage: midi2seq.py song.mid [-n name] [-t tick_ms] [-c channel] [-o song.h]
+#
+# The sequencer plays one note at a time, so the MIDI file is reduced to its top
+# line: whenever notes overlap, the highest one sounds. Percussion (channel 10)
+# is dropped. Times follow the file's tempo map and are rounded to the tick.
+
+import argparse
+import struct
+import sys
+
+TICK_BITS = 9
+TICKS_MAX = (1 << TICK_BITS) - 1
+NOTE_MIN = 16   # NOTE_MIDI_MIN in STM32L432KC_TIM.h
+NOTE_MAX = 127
+
+
+def read_varlen(data, pos):
+    value = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value = (value << 7) | (byte & 0x7F)
+        if not byte & 0x80:
+            return value, pos
+
+
+def parse_track(data):
+    """Yields (tick, kind, a, b) for note on/off and tempo events."""
+    pos, tick, status = 0, 0, 0
+    while pos < len(data):
+        delta, pos = read_varlen(data, pos)
+        tick += delta
+        if data[pos] & 0x80:
+            status = data[pos]
+            pos += 1
+        if status == 0xFF:
+            meta = data[pos]
+            length, pos = read_varlen(data, pos + 1)
+            if meta == 0x51:
+                yield tick, 'tempo', int.from_bytes(data[pos:pos + 3], 'big'), 0
+            elif meta == 0x2F:
+                return
+            pos += length
+        elif status in (0xF0, 0xF7):
+            length, pos = read_varlen(data, pos)
+            pos += length
+        else:
+            kind, channel = status & 0xF0, status & 0x0F
+            size = 1 if kind in (0xC0, 0xD0) else 2
+            args = data[pos:pos + size]
+            pos += size
+            if kind == 0x90 and args[1] > 0:
+                yield tick, 'on', channel, args[0]
+            elif kind in (0x80, 0x90):
+                yield tick, 'off', channel, args[0]
+
+
+def read_midi(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'MThd':
+        sys.exit('%s: not a Standard MIDI File' % path)
+    header_len = struct.unpack('>I', data[4:8])[0]
+    fmt, ntracks, division = struct.unpack('>HHH', data[8:14])
+    if division & 0x8000:
+        sys.exit('%s: SMPTE time division is not supported' % path)
+    if fmt == 2:
+        sys.exit('%s: type 2 (independent tracks) is not supported' % path)
+
+    events = []
+    pos = 8 + header_len
+    for _ in range(ntracks):
+        if data[pos:pos + 4] != b'MTrk':
+            sys.exit('%s: bad track header' % path)
+        length = struct.unpack('>I', data[pos + 4:pos + 8])[0]
+        events.extend(parse_track(data[pos + 8:pos + 8 + length]))
+        pos += 8 + length
+
+    # Tempo changes first at equal ticks, offs before ons so repeated notes retrigger
+    order = {'tempo': 0, 'off': 1, 'on': 2}
+    events.sort(key=lambda e: (e[0], order[e[1]]))
+    return division, events
+
+
+def to_ms(division, events):
+    """Replaces MIDI ticks with ms using the tempo map (default 120 bpm)."""
+    us_per_beat, last_tick, now_us = 500000, 0, 0.0
+    out = []
+    for tick, kind, a, b in events:
+        now_us += (tick - last_tick) * us_per_beat / division
+        last_tick = tick
+        if kind == 'tempo':
+            us_per_beat = a
+        else:
+            out.append((now_us / 1000.0, kind, a, b))
+    return out
+
+
+def melody(events, channel):
+    """Top line as (start_ms, midi) changes, midi 0 for silence."""
+    held = {}
+    changes = []
+    for ms, kind, ch, note in events:
+        if ch == 9 or (channel is not None and ch != channel):
+            continue
+        key = (ch, note)
+        if kind == 'on':
+            held[key] = held.get(key, 0) + 1
+        elif held.get(key):
+            held[key] -= 1
+            if not held[key]:
+                del held[key]
+        top = max((n for _, n in held), default=0)
+        if kind == 'on' and note == top:
+            changes.append((ms, top))  # Retrigger, even on the same pitch
+        elif not changes or changes[-1][1] != top:
+            changes.append((ms, top))
+    return changes
+
+
+def pack(changes, tick_ms):
+    """SEQ_EVENT pairs, rounded on absolute time so rounding never accumulates."""
+    packed = []
+    start = round(changes[0][0] / tick_ms) if changes else 0
+    for (ms, note), (next_ms, _) in zip(changes, changes[1:]):
+        end = round(next_ms / tick_ms)
+        ticks = end - start
+        start = end
+        if ticks <= 0:
+            continue
+        if note and not NOTE_MIN <= note <= NOTE_MAX:
+            note = 0
+        # Long notes and rests split into several events
+        while ticks > TICKS_MAX:
+            packed.append((note, TICKS_MAX))
+            ticks -= TICKS_MAX
+        packed.append((note, ticks))
+
+    # Merge back-to-back rests
+    merged = []
+    for note, ticks in packed:
+        if merged and note == 0 and merged[-1][0] == 0 and merged[-1][1] + ticks <= TICKS_MAX:
+            merged[-1] = (0, merged[-1][1] + ticks)
+        else:
+            merged.append((note, ticks))
+    return merged
+
+
+def main():
+    parser = argparse.ArgumentParser(description='MIDI file to Lab 4 sequencer song')
+    parser.add_argument('midi')
+    parser.add_argument('-n', '--name', default='song', help='C array name')
+    parser.add_argument('-t', '--tick', type=int, default=25, help='tick length in ms (default 25)')
+    parser.add_argument('-c', '--channel', type=int, help='only this MIDI channel, 1-16')
+    parser.add_argument('-o', '--output', help='output file (default stdout)')
+    args = parser.parse_args()
+
+    if not 1 <= args.tick <= 0xFFFF:
+        sys.exit('tick must be 1 to 65535 ms')
+    channel = args.channel - 1 if args.channel else None
+
+    division, events = read_midi(args.midi)
+    packed = pack(melody(to_ms(division, events), channel), args.tick)
+
+    lines = ['// %s: generated by midi2seq.py from %s' % (args.name, args.midi),
+             '// %d events, %d bytes' % (len(packed), 2 * (len(packed) + 2)),
+             'const uint16_t %s[] = {' % args.name,
+             '  %d,' % args.tick]
+    for i in range(0, len(packed), 8):
+        row = packed[i:i + 8]
+        lines.append('  ' + ' '.join('SEQ_EVENT(%d, %d),' % e for e in row))
+    lines += ['  SEQ_END', '};', '']
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    out.write('\n'.join(lines))
+    if args.output:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+# streamsong.py
+# Streams a song to the Lab 4 board over its virtual COM port (main.c with
+# STREAM_PLAYER 1). Protocol in stream.h.
+#
+# usage: streamsong.py /dev/ttyACM0 song.mid [-t tick_ms] [-c channel]
+#        streamsong.py COM5 song.h        (a C array, e.g. from midi2seq.py)
+#
+# Needs pyserial (pip install pyserial).
+
+import argparse
+import os
+import re
+import struct
+import sys
+import time
+
+import midi2seq
+
+STREAM_BLOCK = 64     # stream.h
+STREAM_CREDIT = 0x11
+STREAM_BAUD = 115200
+STREAM_REPLY_S = 5    # Board's reply time on top of the playing time it waits for
+
+
+def block_seconds(block, tick_ms):
+    """Playing time of a block of packed events."""
+    return sum(e & ((1 << midi2seq.TICK_BITS) - 1) for e in block) * tick_ms / 1000.0
+
+
+def load_song(path, tick, channel):
+    """Returns (tick_ms, [events]) without the trailing SEQ_END."""
+    if path.lower().endswith(('.mid', '.midi')):
+        division, events = midi2seq.read_midi(path)
+        notes = midi2seq.melody(midi2seq.to_ms(division, events), channel)
+        packed = midi2seq.pack(notes, tick)
+        return tick, [(n << midi2seq.TICK_BITS) | t for n, t in packed]
+
+    # C array: first number is the tick, then SEQ_EVENT(note, ticks) up to SEQ_END
+    with open(path) as f:
+        text = f.read()
+    body = text[text.index('{') + 1:text.index('SEQ_END')]
+    tick_ms = int(re.match(r'\s*(\d+)', body).group(1))
+    events = [(int(n) << midi2seq.TICK_BITS) | int(t)
+              for n, t in re.findall(r'SEQ_EVENT\(\s*(\d+)\s*,\s*(\d+)\s*\)', body)]
+    return tick_ms, events
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stream a song to the Lab 4 player')
+    parser.add_argument('port')
+    parser.add_argument('song', help='.mid file or C song array')
+    parser.add_argument('-t', '--tick', type=int, default=25, help='tick for .mid files, ms (default 25)')
+    parser.add_argument('-c', '--channel', type=int, help='MIDI channel for .mid files, 1-16')
+    args = parser.parse_args()
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit('streamsong.py needs pyserial: pip install pyserial')
+
+    channel = args.channel - 1 if args.channel else None
+    tick_ms, events = load_song(args.song, args.tick, channel)
+    events.append(0)  # SEQ_END
+    blocks = [events[i:i + STREAM_BLOCK] for i in range(0, len(events), STREAM_BLOCK)]
+    block_s = [block_seconds(block, tick_ms) for block in blocks]
+    length_s = sum(block_s)
+    print('%s: %d events in %d blocks, %.1f s at %d ms/tick'
+          % (os.path.basename(args.song), len(events) - 1, len(blocks), length_s, tick_ms))
+
+    with serial.Serial(args.port, STREAM_BAUD) as port:
+        start = time.time()
+        sent_bytes = 0
+        for n, block in enumerate(blocks):
+            # One credit per block; the board grants two up front, then one as
+            # each block finishes playing. So the credit for block n can take
+            # as long as blocks n-2 and n-1, still queued, take to play.
+            deadline = time.time() + STREAM_REPLY_S + sum(block_s[max(0, n - 2):n])
+            while True:
+                port.timeout = max(0.0, deadline - time.time())
+                byte = port.read(1)
+                if not byte:
+                    if n < 2:
+                        sys.exit('no credit from the board, is STREAM_PLAYER on?')
+                    sys.exit('no credit from the board after block %d' % n)
+                if byte[0] == STREAM_CREDIT:
+                    break
+            data = struct.pack('<%dH' % len(block), *block)
+            if n == 0:
+                data = struct.pack('<H', tick_ms) + data
+            port.write(data)
+            sent_bytes += len(data)
+            print('\rblock %d/%d' % (n + 1, len(blocks)), end='', flush=True)
+
+        elapsed = time.time() - start
+        print('\nsent %d bytes in %.1f s (%.0f B/s needed on average, %d B/s line rate)'
+              % (sent_bytes, elapsed, sent_bytes / length_s if length_s else 0, STREAM_BAUD // 10))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,103 @@
+// STM32L432KC_DMA.c
+// Source code for DMA functions
+
+#include <stdio.h>
+#include <string.h>
+#include "STM32L432KC_DMA.h"
+
+// Owner and interrupt handler of each channel, [0] DMA1, [1] DMA2
+static struct {
+  const char * owner;
+  DmaHandler   handler;
+  void *       ctx;
+} dmaClaims[2][7];
+
+DMA_Channel_TypeDef * dmaChannel(DMA_TypeDef * DMAx, int channel) {
+  // Channel registers start at offset 0x08 and are 0x14 apart
+  return (DMA_Channel_TypeDef *) ((uint32_t) DMAx + 0x08 + 0x14 * (channel - 1));
+}
+
+IRQn_Type dmaIRQn(DMA_TypeDef * DMAx, int channel) {
+  if (DMAx == DMA1) return (IRQn_Type) (DMA1_Channel1_IRQn + channel - 1);
+
+  // DMA2 channels 6 and 7 are not contiguous with 1-5
+  switch (channel) {
+    case 6:
+      return DMA2_Channel6_IRQn;
+    case 7:
+      return DMA2_Channel7_IRQn;
+    default:
+      return (IRQn_Type) (DMA2_Channel1_IRQn + channel - 1);
+  }
+}
+
+int dmaClaim(DMA_TypeDef * DMAx, int channel, const char * owner, DmaHandler handler, void * ctx) {
+  int d = (DMAx == DMA1) ? 0 : 1;
+  const char * held = dmaClaims[d][channel - 1].owner;
+
+  if (held && strcmp(held, owner) != 0) {
+    printf("dma: DMA%d channel %d claimed by %s and %s\n", d + 1, channel, held, owner);
+    return -1;
+  }
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  dmaClaims[d][channel - 1].owner = owner;
+  dmaClaims[d][channel - 1].handler = handler;
+  dmaClaims[d][channel - 1].ctx = ctx;
+  __set_PRIMASK(primask);
+  return 0;
+}
+
+void dmaRelease(DMA_TypeDef * DMAx, int channel) {
+  int d = (DMAx == DMA1) ? 0 : 1;
+
+  dmaChannel(DMAx, channel)->CCR &= ~DMA_CCR_EN;
+  NVIC_DisableIRQ(dmaIRQn(DMAx, channel));
+  dmaClaims[d][channel - 1].owner = 0;
+  dmaClaims[d][channel - 1].handler = 0;
+}
+
+void initDMAChannel(DMA_TypeDef * DMAx, int channel, int request) {
+  DMA_Request_TypeDef * CSELR = (DMAx == DMA1) ? DMA1_CSELR : DMA2_CSELR;
+  uint32_t shift = 4 * (channel - 1);
+
+  RCC->AHB1ENR |= (DMAx == DMA1) ? RCC_AHB1ENR_DMA1EN : RCC_AHB1ENR_DMA2EN;
+
+  dmaChannel(DMAx, channel)->CCR &= ~DMA_CCR_EN;
+  dmaClearFlags(DMAx, channel, DMA_FLAG_GIF);
+  CSELR->CSELR = (CSELR->CSELR & ~(0xFUL << shift)) | ((uint32_t) request << shift);
+}
+
+uint32_t dmaFlags(DMA_TypeDef * DMAx, int channel) {
+  return (DMAx->ISR >> (4 * (channel - 1))) & 0xF;
+}
+
+void dmaClearFlags(DMA_TypeDef * DMAx, int channel, uint32_t flags) {
+  // Clearing GIF clears all four flags of the channel
+  DMAx->IFCR = flags << (4 * (channel - 1));
+}
+
+// Runs the owner's handler. An unclaimed channel's flags are cleared so a
+// stray interrupt can't repeat forever.
+static void dmaDispatch(DMA_TypeDef * DMAx, int channel) {
+  int d = (DMAx == DMA1) ? 0 : 1;
+
+  if (dmaClaims[d][channel - 1].handler) dmaClaims[d][channel - 1].handler(dmaClaims[d][channel - 1].ctx);
+  else dmaClearFlags(DMAx, channel, DMA_FLAG_GIF);
+}
+
+void DMA1_Channel1_IRQHandler(void) { dmaDispatch(DMA1, 1); }
+void DMA1_Channel2_IRQHandler(void) { dmaDispatch(DMA1, 2); }
+void DMA1_Channel3_IRQHandler(void) { dmaDispatch(DMA1, 3); }
+void DMA1_Channel4_IRQHandler(void) { dmaDispatch(DMA1, 4); }
+void DMA1_Channel5_IRQHandler(void) { dmaDispatch(DMA1, 5); }
+void DMA1_Channel6_IRQHandler(void) { dmaDispatch(DMA1, 6); }
+void DMA1_Channel7_IRQHandler(void) { dmaDispatch(DMA1, 7); }
+void DMA2_Channel1_IRQHandler(void) { dmaDispatch(DMA2, 1); }
+void DMA2_Channel2_IRQHandler(void) { dmaDispatch(DMA2, 2); }
+void DMA2_Channel3_IRQHandler(void) { dmaDispatch(DMA2, 3); }
+void DMA2_Channel4_IRQHandler(void) { dmaDispatch(DMA2, 4); }
+void DMA2_Channel5_IRQHandler(void) { dmaDispatch(DMA2, 5); }
+void DMA2_Channel6_IRQHandler(void) { dmaDispatch(DMA2, 6); }
+void DMA2_Channel7_IRQHandler(void) { dmaDispatch(DMA2, 7); }
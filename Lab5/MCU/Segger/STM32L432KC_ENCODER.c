@@ -0,0 +1,60 @@
+// STM32L432KC_ENCODER.c
+// Source code for the TIM2 hardware quadrature encoder interface
+
+#include "STM32L432KC_ENCODER.h"
+
+// Wraps of the 32-bit counter, up minus down
+static volatile int32_t encoderWraps;
+
+void initEncoder(void) {
+  RCC->APB1ENR1 |= RCC_APB1ENR1_TIM2EN;
+
+  ENCODER_TIM->CR1 &= ~TIM_CR1_CEN;
+
+  // CC1S = 01, CC2S = 01: TI1FP1 and TI2FP2 feed the encoder, both filtered
+  ENCODER_TIM->CCER &= ~(TIM_CCER_CC1E | TIM_CCER_CC2E);
+  ENCODER_TIM->CCMR1 = _VAL2FLD(TIM_CCMR1_CC1S, 0b01) | _VAL2FLD(TIM_CCMR1_IC1F, ENCODER_FILTER) |
+                       _VAL2FLD(TIM_CCMR1_CC2S, 0b01) | _VAL2FLD(TIM_CCMR1_IC2F, ENCODER_FILTER);
+
+  // Non-inverted inputs: CC1P/CC1NP and CC2P/CC2NP = 0
+  ENCODER_TIM->CCER &= ~(TIM_CCER_CC1P | TIM_CCER_CC1NP | TIM_CCER_CC2P | TIM_CCER_CC2NP);
+
+  // Encoder mode 3: count on both edges of both inputs
+  ENCODER_TIM->SMCR = (ENCODER_TIM->SMCR & ~TIM_SMCR_SMS) | _VAL2FLD(TIM_SMCR_SMS, 0b011);
+
+  ENCODER_TIM->PSC = 0;
+  ENCODER_TIM->ARR = 0xFFFFFFFF;
+  ENCODER_TIM->CR1 |= TIM_CR1_URS;  // UIF only on a real wrap, not on UG
+  ENCODER_TIM->EGR = TIM_EGR_UG;
+  ENCODER_TIM->CNT = 0;
+  encoderWraps = 0;
+
+  ENCODER_TIM->SR = ~TIM_SR_UIF;
+  ENCODER_TIM->DIER |= TIM_DIER_UIE;
+  NVIC_EnableIRQ(TIM2_IRQn);
+  ENCODER_TIM->CR1 |= TIM_CR1_CEN;
+}
+
+// A wrap from 0xFFFFFFFF up leaves a small count, one from 0 down a large one
+static int32_t encoderWrapDir(uint32_t cnt) {
+  return (cnt < 0x80000000UL) ? 1 : -1;
+}
+
+int64_t encoderPosition(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t cnt = ENCODER_TIM->CNT;
+  int64_t wraps = encoderWraps;
+  // A wrap the interrupt hasn't counted yet
+  if (ENCODER_TIM->SR & TIM_SR_UIF) wraps += encoderWrapDir(cnt);
+
+  __set_PRIMASK(primask);
+  return (int64_t) ((uint64_t) wraps << 32) + cnt;
+}
+
+void TIM2_IRQHandler(void) {
+  if (!(ENCODER_TIM->SR & TIM_SR_UIF)) return;
+  ENCODER_TIM->SR = ~TIM_SR_UIF;
+  encoderWraps += encoderWrapDir(ENCODER_TIM->CNT);
+}
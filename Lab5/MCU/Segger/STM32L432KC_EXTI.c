@@ -0,0 +1,96 @@
+// STM32L432KC_EXTI.c
+// Source code for EXTI (external GPIO interrupt) functions
+
+#include "STM32L432KC_EXTI.h"
+#include "STM32L432KC_GPIO.h"
+
+#define EXTI_PORTS 3 // Ports A, B and C
+
+// Callback table, indexed by EXTI line
+typedef struct {
+  EXTI_Callback callback;
+  void *        ctx;
+  uint8_t       port;
+} EXTI_Line;
+
+static EXTI_Line extiLines[EXTI_LINES];
+
+// Returns the NVIC vector that serves a line
+static IRQn_Type extiLineToIRQn(int line) {
+  if (line <= 4)  return (IRQn_Type) (EXTI0_IRQn + line);
+  if (line <= 9)  return EXTI9_5_IRQn;
+  return EXTI15_10_IRQn;
+}
+
+int attachInterrupt(int gpio_pin, int edge, EXTI_Callback callback, void * ctx) {
+  int line = gpioPinOffset(gpio_pin);
+  int port = gpioPinToPort(gpio_pin);
+  uint32_t line_bit = 1 << line;
+
+  // A line can only watch one port at a time
+  if (extiLines[line].callback != 0 && extiLines[line].port != port) return -1;
+
+  RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+
+  // Mask the line while it is reconfigured
+  EXTI->IMR1 &= ~line_bit;
+
+  extiLines[line].callback = callback;
+  extiLines[line].ctx = ctx;
+  extiLines[line].port = port;
+
+  // Select the port in the line's 4-bit EXTICR field
+  uint32_t shift = 4 * (line & 3);
+  SYSCFG->EXTICR[line >> 2] = (SYSCFG->EXTICR[line >> 2] & ~(0xFUL << shift)) | ((uint32_t) port << shift);
+
+  if (edge & EXTI_RISING) EXTI->RTSR1 |= line_bit;
+  else                    EXTI->RTSR1 &= ~line_bit;
+  if (edge & EXTI_FALLING) EXTI->FTSR1 |= line_bit;
+  else                     EXTI->FTSR1 &= ~line_bit;
+
+  EXTI->PR1 = line_bit; // Drop any edge latched before the callback was set
+  EXTI->IMR1 |= line_bit;
+  NVIC_EnableIRQ(extiLineToIRQn(line));
+
+  return 0;
+}
+
+void detachInterrupt(int gpio_pin) {
+  int line = gpioPinOffset(gpio_pin);
+
+  EXTI->IMR1 &= ~(1 << line);
+  EXTI->PR1 = (1 << line);
+  extiLines[line].callback = 0;
+}
+
+/* Runs the callbacks for every pending, unmasked line in "lines". All pending
+ * bits are cleared with one PR1 write and each port's IDR is read at most
+ * once, so the handler's cost only grows with the number of lines that fired.
+ * Lines are walked highest first using CLZ rather than testing each bit. */
+static void extiDispatch(uint32_t lines) {
+  uint32_t pending = EXTI->PR1 & EXTI->IMR1 & lines;
+  uint32_t idr[EXTI_PORTS];
+  uint32_t latched = 0;
+
+  EXTI->PR1 = pending;
+
+  while (pending) {
+    int line = 31 - __CLZ(pending);
+    pending &= ~(1UL << line);
+
+    EXTI_Line * entry = &extiLines[line];
+    if (!(latched & (1 << entry->port))) {
+      idr[entry->port] = gpioPortToBase(entry->port)->IDR;
+      latched |= (1 << entry->port);
+    }
+    entry->callback(idr[entry->port], entry->ctx);
+  }
+}
+
+void EXTI0_IRQHandler(void)     { extiDispatch(EXTI_IMR1_IM0); }
+void EXTI1_IRQHandler(void)     { extiDispatch(EXTI_IMR1_IM1); }
+void EXTI2_IRQHandler(void)     { extiDispatch(EXTI_IMR1_IM2); }
+void EXTI3_IRQHandler(void)     { extiDispatch(EXTI_IMR1_IM3); }
+void EXTI4_IRQHandler(void)     { extiDispatch(EXTI_IMR1_IM4); }
+void EXTI9_5_IRQHandler(void)   { extiDispatch(0x03E0); } // Lines 5-9
+void EXTI15_10_IRQHandler(void) { extiDispatch(0xFC00); } // Lines 10-15
@@ -0,0 +1,44 @@
+// STM32L432KC_EXTI.h
+// Header for EXTI (external GPIO interrupt) functions
+
+#ifndef STM32L4_EXTI_H
+#define STM32L4_EXTI_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Values which "edge" can take on in attachInterrupt()
+#define EXTI_RISING  1 // Trigger on rising edges
+#define EXTI_FALLING 2 // Trigger on falling edges
+#define EXTI_BOTH    3 // Trigger on both edges
+
+#define EXTI_LINES   16 // One line per pin offset (PA3, PB3 and PC3 share line 3)
+
+/* Called from the EXTI interrupt for each pending line.
+ *    -- idr: the pin's port IDR, sampled once when the interrupt was entered
+ *    -- ctx: the pointer that was passed to attachInterrupt() */
+typedef void (*EXTI_Callback)(uint32_t idr, void * ctx);
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Routes a pin to its EXTI line and calls "callback" on the selected edges.
+ * Sets up SYSCFG->EXTICR, the edge registers, IMR1 and the NVIC vector. Lines
+ * 5-9 and 10-15 share EXTI9_5_IRQn/EXTI15_10_IRQn and are dispatched here, so
+ * do not define those IRQ handlers elsewhere.
+ *    -- gpio_pin: a GPIO pin ID, e.g. PA6
+ *    -- edge: EXTI_RISING, EXTI_FALLING or EXTI_BOTH
+ *    -- callback: function to call from the interrupt
+ *    -- ctx: passed through to the callback
+ *    -- return: 0 on success, -1 if the line is already used by another port */
+int attachInterrupt(int gpio_pin, int edge, EXTI_Callback callback, void * ctx);
+
+/* Masks the pin's EXTI line and removes its callback. */
+void detachInterrupt(int gpio_pin);
+
+#endif
@@ -7,10 +7,43 @@
 #include <stdint.h>
 #include <stm32l432xx.h>
 
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// ART accelerator modes for flashSetART(), OR them together (values match FLASH_ACR)
+#define FLASH_ART_OFF      0
+#define FLASH_ART_PREFETCH FLASH_ACR_PRFTEN // Fetch the next 64-bit line ahead of the core
+#define FLASH_ART_ICACHE   FLASH_ACR_ICEN   // 32 x 64-bit instruction cache
+#define FLASH_ART_DCACHE   FLASH_ACR_DCEN   // 8 x 64-bit cache for literal pools/constants
+#define FLASH_ART_ALL      (FLASH_ART_PREFETCH | FLASH_ART_ICACHE | FLASH_ART_DCACHE)
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
 
+// Sets 4 wait states (80 MHz) and turns the whole ART accelerator on
 void configureFlash();
 
+/* Selects which parts of the ART accelerator are on. Caches that are turned
+ * on again are reset first so they never serve lines from before they were off.
+ *    -- mode: FLASH_ART_OFF or any OR of FLASH_ART_PREFETCH/ICACHE/DCACHE */
+void flashSetART(uint32_t mode);
+
+/* Returns the current ART mode (FLASH_ART_* bits set in FLASH_ACR). */
+uint32_t flashGetART(void);
+
+/* Flushes both caches, e.g. after the flash has been erased or programmed.
+ * Caches that were on are turned back on afterwards. */
+void flashCacheReset(void);
+
+/* Returns the minimum flash wait states for a HCLK frequency (RM Table 12).
+ *    -- hclk: HCLK frequency in Hz
+ *    -- vos_range: regulator voltage range, 1 (up to 80 MHz) or 2 (up to 26 MHz)
+ *    -- return: wait states (0-4), or -1 if hclk is too fast for the range */
+int flashLatency(uint32_t hclk, int vos_range);
+
+/* Sets FLASH_ACR.LATENCY and waits for it to take effect. */
+void setFlashLatency(int wait_states);
+
 #endif
\ No newline at end of file
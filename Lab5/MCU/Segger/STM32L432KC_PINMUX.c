@@ -0,0 +1,101 @@
+// STM32L432KC_PINMUX.c
+// Source code for the board pin-mux table
+
+#include "STM32L432KC.h"
+#include "STM32L432KC_PINMUX.h"
+
+#define PINMUX_PORTS 3 // Ports A, B and C are bonded out on the STM32L432KC
+
+// Register masks/values accumulated for one port
+typedef struct {
+  uint32_t claimed;
+  uint32_t moder_mask,   moder_val;
+  uint32_t ospeedr_mask, ospeedr_val;
+  uint32_t pupdr_mask,   pupdr_val;
+  uint32_t afr_mask[2],  afr_val[2];
+} PinMuxPort;
+
+// Converts the GPIO_PULL_* IDs to the PUPDR field encoding
+static uint32_t pullToPUPDR(int pull) {
+  switch (pull) {
+    case GPIO_PULL_UP:
+      return 0b01;
+    case GPIO_PULL_DOWN:
+      return 0b10;
+    default:
+      return 0b00;
+  }
+}
+
+// Returns the row that first claimed "pin", for conflict reports
+static const PinMux * pinMuxOwner(const PinMux table[], int count, int pin) {
+  for (int i = 0; i < count; i++) {
+    if (table[i].pin == pin) return &table[i];
+  }
+  return 0;
+}
+
+int pinMuxInit(const PinMux table[], int count) {
+  PinMuxPort ports[PINMUX_PORTS] = {0};
+  int conflicts = 0;
+
+  // Merge every row into its port's register masks
+  for (int i = 0; i < count; i++) {
+    const PinMux * row = &table[i];
+    int port = gpioPinToPort(row->pin);
+    int pin_offset = gpioPinOffset(row->pin);
+    uint32_t pin_bit = 1 << pin_offset;
+
+    if (port >= PINMUX_PORTS) {
+      printf("pinmux: %s claims invalid pin %d\n", row->owner, row->pin);
+      conflicts++;
+      continue;
+    }
+    if (ports[port].claimed & pin_bit) {
+      printf("pinmux: P%c%d claimed by %s and %s\n", 'A' + port, pin_offset,
+             pinMuxOwner(table, i, row->pin)->owner, row->owner);
+      conflicts++;
+      continue;
+    }
+
+    PinMuxPort * p = &ports[port];
+    p->claimed      |= pin_bit;
+    p->moder_mask   |= (0b11 << 2*pin_offset);
+    p->moder_val    |= ((uint32_t) row->mode << 2*pin_offset);
+    p->ospeedr_mask |= (0b11 << 2*pin_offset);
+    p->ospeedr_val  |= ((uint32_t) row->speed << 2*pin_offset);
+    p->pupdr_mask   |= (0b11 << 2*pin_offset);
+    p->pupdr_val    |= (pullToPUPDR(row->pull) << 2*pin_offset);
+
+    if (row->mode == GPIO_ALT) {
+      // AFR[0] holds pins 0-7 and AFR[1] pins 8-15, four bits each
+      int afr = pin_offset >> 3;
+      p->afr_mask[afr] |= (0xFUL << 4*(pin_offset & 7));
+      p->afr_val[afr]  |= ((uint32_t) (row->af & 0xF) << 4*(pin_offset & 7));
+    }
+  }
+
+  if (conflicts) return conflicts;
+
+  // Turn on every used port's clock at once
+  uint32_t port_clocks = 0;
+  for (int port = 0; port < PINMUX_PORTS; port++) {
+    if (ports[port].claimed) port_clocks |= (RCC_AHB2ENR_GPIOAEN << port);
+  }
+  RCC->AHB2ENR |= port_clocks;
+
+  // One masked write per register per port
+  for (int port = 0; port < PINMUX_PORTS; port++) {
+    PinMuxPort * p = &ports[port];
+    if (!p->claimed) continue;
+
+    GPIO_TypeDef * GPIO_PORT_PTR = gpioPortToBase(port);
+    GPIO_PORT_PTR->OSPEEDR = (GPIO_PORT_PTR->OSPEEDR & ~p->ospeedr_mask) | p->ospeedr_val;
+    GPIO_PORT_PTR->PUPDR   = (GPIO_PORT_PTR->PUPDR & ~p->pupdr_mask) | p->pupdr_val;
+    if (p->afr_mask[0]) GPIO_PORT_PTR->AFR[0] = (GPIO_PORT_PTR->AFR[0] & ~p->afr_mask[0]) | p->afr_val[0];
+    if (p->afr_mask[1]) GPIO_PORT_PTR->AFR[1] = (GPIO_PORT_PTR->AFR[1] & ~p->afr_mask[1]) | p->afr_val[1];
+    GPIO_PORT_PTR->MODER   = (GPIO_PORT_PTR->MODER & ~p->moder_mask) | p->moder_val;
+  }
+
+  return 0;
+}
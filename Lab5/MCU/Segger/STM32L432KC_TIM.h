@@ -5,15 +5,18 @@
 #define STM32L4_TIM_H
 
 #include <stdint.h> // Include stdint header
-#include <stm32l432xx.h>
+#include <stm32l432xx.h>  // CMSIS device library include
 #include "STM32L432KC_GPIO.h"
 
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
 
 void initTIM(TIM_TypeDef * TIMx);
+// Starts TIMx with update events at rate_hz. rate_hz 0 leaves the timer stopped.
+void initTIMRate(TIM_TypeDef * TIMx, uint32_t rate_hz);
+// Waits ms milliseconds: sleeps on the SysTick tick after initTick(), otherwise spins on TIMx
 void delay_millis(TIM_TypeDef * TIMx, uint32_t ms);
-void delay_micros(TIM_TypeDef * TIMx, uint32_t us);
 
 #endif
\ No newline at end of file
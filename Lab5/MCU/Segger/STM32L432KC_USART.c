@@ -4,7 +4,11 @@
 #include "STM32L432KC.h"
 #include "STM32L432KC_USART.h"
 #include "STM32L432KC_GPIO.h"
+#include "STM32L432KC_DMA.h"
 #include "STM32L432KC_RCC.h"
+#include "STM32L432KC_TICK.h"
+#include <stdlib.h>
+#include <string.h>
 
 USART_TypeDef * id2Port(int USART_ID) {
     USART_TypeDef * USART;
@@ -21,8 +25,187 @@ USART_TypeDef * id2Port(int USART_ID) {
     return USART;
 }
 
+// Baud rate requested for each USART, kept so BRR can follow clock changes
+static uint32_t usartBaud[3];
+
+// Ring indexes run freely and are masked on use, so head - tail is the fill.
+// Each index has one writer: the caller owns txHead and rxTail, the IRQ owns
+// txTail and rxHead.
+typedef struct {
+    uint8_t           tx[USART_TX_BUFFER];
+    uint8_t           rx[USART_RX_BUFFER];
+    volatile uint32_t txHead, txTail;
+    volatile uint32_t rxHead, rxTail;
+    volatile uint32_t rxDropped;
+    volatile uint32_t rxErrors;
+    volatile uint32_t rxOverruns;
+    int               flow;      // RTS/CTS on
+    volatile int      rxStalled; // RX ring full, RTS held off until usartRead()
+
+    // DMA gather transmit
+    const UsartFragment * frags;
+    int                   fragCount;
+    int                   fragNext;
+    UsartTxCallback       done;
+    void *                doneCtx;
+    volatile int          dmaQueued;  // Waiting for the ring to reach dmaAt
+    volatile int          dmaActive;
+    uint32_t              dmaAt;      // txHead when the fragments were queued
+
+    // DMA frame receive. Positions run freely; the ring index is pos % size.
+    uint8_t *             frameRing;
+    uint32_t              frameSize;
+    int                   frameMatch;
+    UsartFrameCallback    onFrame;
+    void *                frameCtx;
+    uint32_t              rxWritten;  // Bytes the DMA has written
+    uint32_t              frameStart; // Start of the frame being received
+    volatile uint32_t     rxReleased; // Everything before this is free
+    uint32_t              dmaLast;    // Ring index of the DMA at the last check
+} UsartState;
+
+static UsartState usartState[2];
+
+// TX and RX DMA channels of each USART (RM Table 41)
+static const struct {
+    DMA_TypeDef * DMAx;
+    int           channel;
+} usartTxDMA[2] = {
+    {DMA1, 4},
+    {DMA1, 7},
+}, usartRxDMA[2] = {
+    {DMA2, 7},
+    {DMA1, 6},
+};
+
+// DMA channel interrupts, registered with dmaClaim()
+static void usartDMAIRQ(void * ctx);
+static void usartRxDMAIRQ(void * ctx);
+
+static int port2Index(USART_TypeDef * USART) {
+    return (USART == USART1) ? 0 : 1;
+}
+
+static UsartState * port2State(USART_TypeDef * USART) {
+    return &usartState[port2Index(USART)];
+}
+
+// CCIPR USARTxSEL field of USART_ID: 0b00 PCLK, 0b01 SYSCLK, 0b10 HSI16, 0b11 LSE
+static uint32_t usartClockSel(int USART_ID) {
+    return (USART_ID == USART1_ID) ? _FLD2VAL(RCC_CCIPR_USART1SEL, RCC->CCIPR)
+                                   : _FLD2VAL(RCC_CCIPR_USART2SEL, RCC->CCIPR);
+}
+
+// Returns the kernel clock feeding USART_ID.
+// PCLK and SYSCLK both equal HCLK here since the APB prescalers are left at 1.
+static uint32_t usartKernelClock(int USART_ID) {
+    switch(usartClockSel(USART_ID)){
+        case 0b10 : return HSI_FREQ;
+        case 0b11 : return 32768; // LSE
+        default   : return SystemCoreClock;
+    }
+}
+
+static int port2ID(USART_TypeDef * USART) {
+    return (USART == USART1) ? USART1_ID : USART2_ID;
+}
+
+// Clocks per bit for baud, rounded to nearest rather than truncated
+static uint32_t usartClocksPerBit(uint32_t f_ck, uint32_t baud) {
+    return (f_ck + baud / 2) / baud;
+}
+
+// USARTDIV for baud from f_ck, and whether it needs OVER8. OVER16 counts
+// clocks per bit (baud = f_CK / USARTDIV). Below 16 clocks per bit OVER8
+// counts half clocks (baud = 2 f_CK / USARTDIV), but BRR can't hold bit 0 of
+// USARTDIV (RM 38.5.4), so of round(2 f_CK / baud) only an even neighbour
+// can be loaded: the one nearer in rate.
+static uint32_t usartDivider(uint32_t f_ck, uint32_t baud, int * over8) {
+    uint32_t div = usartClocksPerBit(f_ck, baud);
+
+    *over8 = (div < 16);
+    if (!*over8) return div;
+
+    div = (uint32_t) (((uint64_t) 2 * f_ck + baud / 2) / baud);
+    if (div & 1) {
+        uint64_t lo = div - 1, hi = div + 1;
+        // 2 f/lo - baud < baud - 2 f/hi
+        div = ((uint64_t) f_ck * (lo + hi) < (uint64_t) baud * lo * hi) ? lo : hi;
+    }
+    return div;
+}
+
+static int32_t usartErrorPPM(uint32_t f_ck, uint32_t baud) {
+    int over8;
+    if (baud == 0) return USART_BAUD_UNREACHABLE;
+    uint32_t div = usartDivider(f_ck, baud, &over8);
+    if ((over8 && div < 16) || div > 0xFFFF) return USART_BAUD_UNREACHABLE;
+    // Same divider as usartLoadBRR() loads
+    uint64_t f_div = over8 ? 2 * (uint64_t) f_ck : f_ck;
+    return (int32_t) (((int64_t) (f_div * 1000000 / div) - (int64_t) baud * 1000000) / baud);
+}
+
+// Resolves USART_CLOCK_AUTO to the clock with the smaller error
+static int usartPickClock(uint32_t baud, int clock) {
+    if (clock != USART_CLOCK_AUTO) return clock;
+
+    int32_t hsi = usartErrorPPM(HSI_FREQ, baud);
+    int32_t pclk = usartErrorPPM(SystemCoreClock, baud);
+    if (hsi == USART_BAUD_UNREACHABLE) return USART_CLOCK_PCLK;
+    if (pclk == USART_BAUD_UNREACHABLE) return USART_CLOCK_HSI;
+    return (abs(pclk) < abs(hsi)) ? USART_CLOCK_PCLK : USART_CLOCK_HSI;
+}
+
+// Loads BRR and OVER8 for baud from f_ck. UE must be 0.
+static void usartLoadBRR(USART_TypeDef * USART, uint32_t f_ck, uint32_t baud) {
+    int over8;
+    uint32_t div = usartDivider(f_ck, baud, &over8);
+
+    if (!over8) {
+        if (div > 0xFFFF) div = 0xFFFF;
+        USART->CR1 &= ~USART_CR1_OVER8; // Baud = f_CK / USARTDIV, USARTDIV = BRR
+        USART->BRR = (uint16_t) div;
+    } else {
+        if (div < 16) div = 16;
+        // Baud = 2 f_CK / USARTDIV, with BRR[2:0] = USARTDIV[3:1] (RM 38.5.4)
+        USART->CR1 |= USART_CR1_OVER8;
+        USART->BRR = (uint16_t) ((div & 0xFFF0) | ((div & 0xF) >> 1));
+    }
+}
+
+// Selects the kernel clock and loads the divider, with the USART disabled
+static void usartApplyBaud(USART_TypeDef * USART, uint32_t baud, int clock) {
+    int id = port2ID(USART);
+    uint32_t sel = (usartPickClock(baud, clock) == USART_CLOCK_HSI) ? 0b10 : 0b00;
+    uint32_t ue = USART->CR1 & USART_CR1_UE;
+
+    if (ue) while(!(USART->ISR & USART_ISR_TC)); // Let the frame in flight finish
+    USART->CR1 &= ~USART_CR1_UE; // BRR and OVER8 can only be written with UE = 0
+
+    if (id == USART1_ID) RCC->CCIPR = (RCC->CCIPR & ~RCC_CCIPR_USART1SEL) | _VAL2FLD(RCC_CCIPR_USART1SEL, sel);
+    else                 RCC->CCIPR = (RCC->CCIPR & ~RCC_CCIPR_USART2SEL) | _VAL2FLD(RCC_CCIPR_USART2SEL, sel);
+    usartLoadBRR(USART, usartKernelClock(id), baud);
+    usartBaud[id] = baud;
+
+    USART->CR1 |= ue;
+}
+
+// Clock listener: reloads BRR for USARTs clocked from PCLK/SYSCLK.
+// HSI16-clocked USARTs are unaffected by HCLK changes.
+static void usartClockChanged(uint32_t hclk, void * ctx) {
+    for (int id = USART1_ID; id <= USART2_ID; id++) {
+        USART_TypeDef * USART = id2Port(id);
+        uint32_t sel = usartClockSel(id);
+        if (usartBaud[id] == 0 || sel == 0b10 || sel == 0b11) continue;
+
+        while(!(USART->ISR & USART_ISR_TC)); // Let the frame in flight finish
+        USART->CR1 &= ~USART_CR1_UE;         // BRR can only be written with UE = 0
+        usartLoadBRR(USART, hclk, usartBaud[id]);
+        USART->CR1 |= USART_CR1_UE;
+    }
+}
+
 USART_TypeDef * initUSART(int USART_ID, int baud_rate) {
-    gpioEnable(GPIO_PORT_A);  // Enable clock for GPIOA
     RCC->CR |= RCC_CR_HSION;  // Turn on HSI 16 MHz clock
 
     USART_TypeDef * USART = id2Port(USART_ID); // Get pointer to USART
@@ -30,72 +213,466 @@ USART_TypeDef * initUSART(int USART_ID, int baud_rate) {
     switch(USART_ID){
         case USART1_ID :
             RCC->APB2ENR |= RCC_APB2ENR_USART1EN; // Set USART1EN
-            RCC->CCIPR |= (0b10 << RCC_CCIPR_USART1SEL_Pos); // Set HSI16 (16 MHz) as USART clock source
-
-            GPIOA->AFR[1] |= (0b111 << GPIO_AFRH_AFSEL9_Pos) | (0b111 << GPIO_AFRH_AFSEL10_Pos);
-
-            // Configure pin modes as ALT function
-            pinMode(PA9, GPIO_ALT); // TX
-            pinMode(PA10, GPIO_ALT); // RX
-
             break;
         case USART2_ID :
             RCC->APB1ENR1 |= RCC_APB1ENR1_USART2EN; // Set USART2EN
-            RCC->CCIPR |= (0b10 << RCC_CCIPR_USART2SEL_Pos); // Set HSI16 (16 MHz) as USART clock source
-
-            // Configure pin modes as ALT function
-            pinMode(PA2, GPIO_ALT); // TX
-            pinMode(PA15, GPIO_ALT); // RX
-
-            // Configure correct alternate functions
-            GPIOA->AFR[0] |= (0b111 << GPIO_AFRL_AFSEL2_Pos);   //AF7
-            GPIOA->AFR[1] |= (0b011 << GPIO_AFRH_AFSEL15_Pos);  //AF3
             break;
     }
 
     // Set M = 00
     USART->CR1 &= ~(USART_CR1_M0 | USART_CR1_M1);    // M=00 corresponds to 1 start bit, 8 data bits, n stop bits
-    USART->CR1 &= ~USART_CR1_OVER8; // Set to 16 times sampling freq
     USART->CR2 &= ~USART_CR2_STOP;  // 0b00 corresponds to 1 stop bit
 
-    // Set baud rate to 115200 (see RM 38.5.4 for details)
-    // Tx/Rx baud = f_CK/USARTDIV (since oversampling by 16)
-    // f_CK = 16 MHz (HSI)
+    // Kernel clock, oversampling and divider (see RM 38.5.4 for details).
+    // HSI16 wins the usual rates, whose divider it has exactly.
+    if (usartBaud[1] == 0 && usartBaud[2] == 0) clockAddListener(usartClockChanged, 0);
+    usartApplyBaud(USART, baud_rate, USART_CLOCK_AUTO);
 
-    USART->BRR = (uint16_t) (HSI_FREQ / baud_rate);
+    UsartState * st = port2State(USART);
+    st->txHead = st->txTail = 0;
+    st->rxHead = st->rxTail = 0;
+    st->rxDropped = 0;
+    st->rxErrors = 0;
+    st->rxOverruns = 0;
+    st->flow = st->rxStalled = 0;
 
     USART->CR1 |= USART_CR1_UE;     // Enable USART
     USART->CR1 |= USART_CR1_TE | USART_CR1_RE; // Enable transmission and reception
 
+    // Receive into the RX ring; TXEIE is only set while TX has bytes queued
+    USART->CR1 |= USART_CR1_RXNEIE;
+    NVIC_EnableIRQ((USART_ID == USART1_ID) ? USART1_IRQn : USART2_IRQn);
+
     return USART;
 }
 
-void sendChar(USART_TypeDef * USART, char data){
-    while(!(USART->ISR & USART_ISR_TXE));
-    USART->TDR = data;
-    while(!(USART->ISR & USART_ISR_TC));
+// Takes reception back up after a flow-control stall, once the ring has room
+static void usartRxResume(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+
+    if (!st->rxStalled) return;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq(); // CR1 is shared with the IRQs' TXEIE updates
+    st->rxStalled = 0;
+    USART->CR1 |= USART_CR1_RXNEIE;
+    __set_PRIMASK(primask);
 }
 
-void sendString(USART_TypeDef * USART, char * charArray){
+int usartSetBaud(USART_TypeDef * USART, uint32_t baud, int clock) {
+    int32_t error = usartBaudError(USART, baud, clock);
+
+    if (error == USART_BAUD_UNREACHABLE || abs(error) > USART_BAUD_TOLERANCE) return -1;
+    usartApplyBaud(USART, baud, clock);
+    return 0;
+}
+
+int32_t usartBaudError(USART_TypeDef * USART, uint32_t baud, int clock) {
+    clock = usartPickClock(baud, clock);
+    return usartErrorPPM((clock == USART_CLOCK_HSI) ? HSI_FREQ : SystemCoreClock, baud);
+}
+
+uint32_t usartGetBaud(USART_TypeDef * USART) {
+    uint32_t f_ck = usartKernelClock(port2ID(USART));
+    uint32_t brr = USART->BRR;
+
+    if (!(USART->CR1 & USART_CR1_OVER8)) return brr ? f_ck / brr : 0;
+    uint32_t div = (brr & 0xFFF0) | ((brr & 0x7) << 1);
+    return div ? 2 * f_ck / div : 0;
+}
+
+uint32_t usartErrors(USART_TypeDef * USART) {
+    return port2State(USART)->rxErrors;
+}
+
+int usartSetFlowControl(USART_TypeDef * USART, int enable) {
+    UsartState * st = port2State(USART);
+    uint32_t ue = USART->CR1 & USART_CR1_UE;
+
+    if (ue) while(!(USART->ISR & USART_ISR_TC)); // Let the frame in flight finish
+    USART->CR1 &= ~USART_CR1_UE; // RTSE and CTSE can only be written with UE = 0
+    if (enable) USART->CR3 |= USART_CR3_RTSE | USART_CR3_CTSE;
+    else        USART->CR3 &= ~(USART_CR3_RTSE | USART_CR3_CTSE);
+    USART->CR1 |= ue;
+
+    st->flow = enable;
+    if (!enable) usartRxResume(USART);
+    return 0;
+}
+
+uint32_t usartOverruns(USART_TypeDef * USART) {
+    return port2State(USART)->rxOverruns;
+}
+
+// Finite timeouts need the tick; without it they wait forever
+static int usartExpired(uint32_t start, uint32_t timeout_ms) {
+    if (timeout_ms == USART_FOREVER || !tickRunning()) return 0;
+    return (millis() - start) >= timeout_ms;
+}
+
+int usartWrite(USART_TypeDef * USART, const void * data, int len) {
+    UsartState * st = port2State(USART);
+    const uint8_t * bytes = data;
+    uint32_t head = st->txHead;
+    uint32_t space = USART_TX_BUFFER - (head - st->txTail);
+    int n = (len < (int) space) ? len : (int) space;
+
+    for (int i = 0; i < n; i++) st->tx[(head + i) & (USART_TX_BUFFER - 1)] = bytes[i];
+    st->txHead = head + n; // Publish after the bytes are in place
+
+    // The IRQ clears TXEIE when it finds the ring empty. This code can't run
+    // between that check and the clear, so a byte queued here is never stranded.
+    // During a DMA transmit the DMA interrupt sets it once the DMA is done.
+    if (n && !st->dmaActive) USART->CR1 |= USART_CR1_TXEIE;
+    return n;
+}
+
+int usartRead(USART_TypeDef * USART, void * data, int len) {
+    UsartState * st = port2State(USART);
+    uint8_t * bytes = data;
+    uint32_t tail = st->rxTail;
+    uint32_t fill = st->rxHead - tail;
+    int n = (len < (int) fill) ? len : (int) fill;
+
+    for (int i = 0; i < n; i++) bytes[i] = st->rx[(tail + i) & (USART_RX_BUFFER - 1)];
+    st->rxTail = tail + n; // Free the slots only once they've been copied
+    if (n) usartRxResume(USART);
+    return n;
+}
+
+int usartWriteTimeout(USART_TypeDef * USART, const void * data, int len, uint32_t timeout_ms) {
+    const uint8_t * bytes = data;
+    uint32_t start = millis();
+    int done = usartWrite(USART, bytes, len);
+
+    while (done < len && !usartExpired(start, timeout_ms)) {
+        __WFI(); // The TX interrupt frees space, the tick ends the wait
+        done += usartWrite(USART, bytes + done, len - done);
+    }
+    return done;
+}
+
+int usartReadTimeout(USART_TypeDef * USART, void * data, int len, uint32_t timeout_ms) {
+    uint8_t * bytes = data;
+    uint32_t start = millis();
+    int done = usartRead(USART, bytes, len);
+
+    while (done < len && !usartExpired(start, timeout_ms)) {
+        __WFI();
+        done += usartRead(USART, bytes + done, len - done);
+    }
+    return done;
+}
+
+int usartFlush(USART_TypeDef * USART, uint32_t timeout_ms) {
+    uint32_t start = millis();
+
+    while (usartPending(USART) || usartDMABusy(USART) || !(USART->ISR & USART_ISR_TC)) {
+        if (usartExpired(start, timeout_ms)) return -1;
+    }
+    return 0;
+}
+
+int usartAvailable(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+    return (int) (st->rxHead - st->rxTail);
+}
+
+int usartPending(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+    return (int) (st->txHead - st->txTail);
+}
+
+uint32_t usartDropped(USART_TypeDef * USART) {
+    return port2State(USART)->rxDropped;
+}
+
+// Points the channel at the next non-empty fragment, or ends the transmit:
+// DMA off, ring transmission back on, callback. Runs with the USART and DMA
+// interrupts unable to preempt it.
+static void usartDMANext(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+    int i = port2Index(USART);
+    DMA_Channel_TypeDef * chan = dmaChannel(usartTxDMA[i].DMAx, usartTxDMA[i].channel);
+
+    chan->CCR &= ~DMA_CCR_EN;
+    while (st->fragNext < st->fragCount && st->frags[st->fragNext].len == 0) st->fragNext++;
+
+    if (st->fragNext < st->fragCount) {
+        const UsartFragment * frag = &st->frags[st->fragNext++];
+        chan->CMAR = (uint32_t) frag->data;
+        chan->CNDTR = frag->len;
+        chan->CCR |= DMA_CCR_EN;
+        return;
+    }
+
+    USART->CR3 &= ~USART_CR3_DMAT;
+    st->dmaActive = 0;
+    if (st->txHead != st->txTail) USART->CR1 |= USART_CR1_TXEIE;
+    if (st->done) st->done(st->doneCtx);
+}
+
+// Starts the queued fragments once the ring bytes ahead of them have gone
+static void usartDMAStart(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+
+    st->dmaQueued = 0;
+    st->dmaActive = 1;
+    USART->CR3 |= USART_CR3_DMAT;
+    usartDMANext(USART);
+}
+
+int usartSendFragments(USART_TypeDef * USART, const UsartFragment * list, int count,
+                       UsartTxCallback done, void * ctx) {
+    UsartState * st = port2State(USART);
+    int i = port2Index(USART);
+    DMA_TypeDef * DMAx = usartTxDMA[i].DMAx;
+    int channel = usartTxDMA[i].channel;
+
+    if (st->dmaActive || st->dmaQueued) return -1;
+    if (dmaClaim(DMAx, channel, (i == 0) ? "USART1 TX" : "USART2 TX", usartDMAIRQ, USART) < 0) return -1;
+
+    // Memory -> TDR, bytes, one fragment per transfer
+    initDMAChannel(DMAx, channel, (i == 0) ? DMA_REQ_USART1_TX : DMA_REQ_USART2_TX);
+    DMA_Channel_TypeDef * chan = dmaChannel(DMAx, channel);
+    chan->CPAR = (uint32_t) &USART->TDR;
+    chan->CCR = DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_TCIE | DMA_CCR_TEIE;
+    NVIC_EnableIRQ(dmaIRQn(DMAx, channel));
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    st->frags = list;
+    st->fragCount = count;
+    st->fragNext = 0;
+    st->done = done;
+    st->doneCtx = ctx;
+    st->dmaAt = st->txHead;
+    if (st->txTail == st->dmaAt) usartDMAStart(USART);
+    else st->dmaQueued = 1; // The TX interrupt starts it at dmaAt
+    __set_PRIMASK(primask);
+
+    return 0;
+}
 
-    uint32_t i = 0;
-    do{
-        sendChar(USART, charArray[i]);
-        i++;
+int usartDMABusy(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+    return st->dmaActive || st->dmaQueued;
+}
+
+// Transfer complete: chain the next fragment. A transfer error (bad address)
+// disables the channel, so end the transmit there.
+static void usartDMAIRQ(void * ctx) {
+    USART_TypeDef * USART = ctx;
+    UsartState * st = port2State(USART);
+    int i = port2Index(USART);
+    uint32_t flags = dmaFlags(usartTxDMA[i].DMAx, usartTxDMA[i].channel);
+
+    dmaClearFlags(usartTxDMA[i].DMAx, usartTxDMA[i].channel, DMA_FLAG_GIF);
+    if (!st->dmaActive) return;
+    if (flags & DMA_FLAG_TE) st->fragNext = st->fragCount;
+    if (flags & (DMA_FLAG_TC | DMA_FLAG_TE)) usartDMANext(USART);
+}
+
+// Advances rxWritten to the DMA's position. The half and full transfer
+// interrupts call this too, so the DMA never gets a whole ring ahead.
+static void usartRxCatchUp(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+    int i = port2Index(USART);
+    uint32_t pos = st->frameSize - dmaChannel(usartRxDMA[i].DMAx, usartRxDMA[i].channel)->CNDTR;
+
+    if (pos == st->frameSize) pos = 0;
+    st->rxWritten += (pos + st->frameSize - st->dmaLast) % st->frameSize;
+    st->dmaLast = pos;
+
+    // Unreleased bytes the DMA has written over
+    uint32_t released = st->rxReleased;
+    if (st->rxWritten - released > st->frameSize) {
+        st->rxDropped += st->rxWritten - released - st->frameSize;
+        st->rxReleased = st->rxWritten - st->frameSize;
+        if ((int32_t) (st->frameStart - st->rxReleased) < 0) st->frameStart = st->rxReleased;
     }
-    while(charArray[i] != 0);
+}
+
+// Hands the bytes since the last frame to the callback
+static void usartRxFrame(USART_TypeDef * USART, int matched) {
+    UsartState * st = port2State(USART);
+    uint32_t len = st->rxWritten - st->frameStart;
+    uint32_t index = st->frameStart % st->frameSize;
+    UsartFrame frame;
+
+    if (len == 0) return;
+
+    frame.data[0] = &st->frameRing[index];
+    frame.len[0] = (index + len > st->frameSize) ? st->frameSize - index : len;
+    frame.data[1] = st->frameRing;
+    frame.len[1] = len - frame.len[0];
+    frame.matched = matched;
+    frame.end = st->rxWritten;
+    st->frameStart = st->rxWritten;
+
+    if (st->onFrame) st->onFrame(&frame, st->frameCtx);
+}
+
+int usartReceiveFrames(USART_TypeDef * USART, uint8_t * ring, int size, int match,
+                       UsartFrameCallback done, void * ctx) {
+    UsartState * st = port2State(USART);
+    int i = port2Index(USART);
+    DMA_TypeDef * DMAx = usartRxDMA[i].DMAx;
+    int channel = usartRxDMA[i].channel;
+
+    if (dmaClaim(DMAx, channel, (i == 0) ? "USART1 RX" : "USART2 RX", usartRxDMAIRQ, USART) < 0) return -1;
+    USART->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_CMIE | USART_CR1_IDLEIE);
+
+    st->frameRing = ring;
+    st->frameSize = size;
+    st->frameMatch = match;
+    st->onFrame = done;
+    st->frameCtx = ctx;
+    st->rxWritten = st->frameStart = st->rxReleased = 0;
+    st->dmaLast = 0;
+    st->rxDropped = 0;
+    st->rxStalled = 0; // RXNEIE is off for good
+
+    // RDR -> ring, bytes, circular; HT/TC only keep rxWritten current
+    initDMAChannel(DMAx, channel, (i == 0) ? DMA_REQ_USART1_RX : DMA_REQ_USART2_RX);
+    DMA_Channel_TypeDef * chan = dmaChannel(DMAx, channel);
+    chan->CPAR = (uint32_t) &USART->RDR;
+    chan->CMAR = (uint32_t) ring;
+    chan->CNDTR = size;
+    chan->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+    NVIC_EnableIRQ(dmaIRQn(DMAx, channel));
+    chan->CCR |= DMA_CCR_EN;
+
+    // ADD can only be written with the USART disabled
+    if (match != USART_NO_MATCH) {
+        while(!(USART->ISR & USART_ISR_TC)); // Let the frame in flight finish
+        USART->CR1 &= ~USART_CR1_UE;
+        USART->CR2 = (USART->CR2 & ~USART_CR2_ADD) | _VAL2FLD(USART_CR2_ADD, (uint8_t) match);
+        USART->CR1 |= USART_CR1_UE;
+    }
+
+    USART->ICR = USART_ICR_CMCF | USART_ICR_IDLECF | USART_ICR_ORECF;
+    USART->CR3 |= USART_CR3_DMAR | USART_CR3_EIE; // Line errors interrupt without RXNE
+    USART->CR1 |= USART_CR1_IDLEIE | ((match != USART_NO_MATCH) ? USART_CR1_CMIE : 0);
+    return 0;
+}
+
+void usartReleaseFrame(USART_TypeDef * USART, const UsartFrame * frame) {
+    UsartState * st = port2State(USART);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if ((int32_t) (frame->end - st->rxReleased) > 0) st->rxReleased = frame->end;
+    __set_PRIMASK(primask);
+}
+
+int usartFrameString(const UsartFrame * frame, char * dst, int max) {
+    int n = 0;
+
+    for (int part = 0; part < 2; part++) {
+        int len = frame->len[part];
+        if (len > max - 1 - n) len = max - 1 - n;
+        memcpy(dst + n, frame->data[part], len);
+        n += len;
+    }
+    dst[n] = 0;
+    return n;
+}
+
+static void usartRxDMAIRQ(void * ctx) {
+    USART_TypeDef * USART = ctx;
+    int i = port2Index(USART);
+
+    dmaClearFlags(usartRxDMA[i].DMAx, usartRxDMA[i].channel, DMA_FLAG_GIF);
+    usartRxCatchUp(USART);
+}
+
+// Moves one received byte into the RX ring and one queued byte to TDR
+static void usartIRQ(USART_TypeDef * USART) {
+    UsartState * st = port2State(USART);
+    uint32_t isr = USART->ISR;
+
+    if (isr & USART_ISR_ORE) {
+        USART->ICR = USART_ICR_ORECF; // Else RXNE stops coming
+        st->rxOverruns++;
+    }
+    if (isr & (USART_ISR_FE | USART_ISR_NE | USART_ISR_PE)) {
+        USART->ICR = USART_ICR_FECF | USART_ICR_NECF | USART_ICR_PECF;
+        st->rxErrors++;
+    }
+
+    // Frame receive: CMF is set as the match character lands in RDR, and the
+    // DMA may not have stored it yet. IDLE ends whatever came since.
+    if (isr & (USART_ISR_CMF | USART_ISR_IDLE)) {
+        USART->ICR = USART_ICR_CMCF | USART_ICR_IDLECF;
+        if (st->frameRing) {
+            usartRxCatchUp(USART);
+            if (isr & USART_ISR_CMF) {
+                for (int tries = 0; tries < 8 && (st->rxWritten == st->frameStart ||
+                     st->frameRing[(st->rxWritten - 1) % st->frameSize] != (uint8_t) st->frameMatch); tries++) {
+                    usartRxCatchUp(USART);
+                }
+            }
+            usartRxFrame(USART, (isr & USART_ISR_CMF) != 0);
+        }
+    }
+
+    if ((USART->CR1 & USART_CR1_RXNEIE) && (isr & USART_ISR_RXNE)) {
+        uint32_t head = st->rxHead;
+        if (st->flow && head - st->rxTail >= USART_RX_BUFFER) {
+            // Leave the byte in RDR: RTS stays high until usartRead() makes room
+            USART->CR1 &= ~USART_CR1_RXNEIE;
+            st->rxStalled = 1;
+        } else {
+            uint8_t data = (uint8_t) USART->RDR; // Reading RDR clears RXNE
+            if (head - st->rxTail < USART_RX_BUFFER) {
+                st->rx[head & (USART_RX_BUFFER - 1)] = data;
+                st->rxHead = head + 1;
+            } else {
+                st->rxDropped++;
+            }
+        }
+    }
+
+    if ((USART->CR1 & USART_CR1_TXEIE) && (isr & USART_ISR_TXE)) {
+        uint32_t tail = st->txTail;
+        if (st->dmaActive) {
+            USART->CR1 &= ~USART_CR1_TXEIE; // The DMA owns TDR until it's done
+        } else if (st->dmaQueued && tail == st->dmaAt) {
+            USART->CR1 &= ~USART_CR1_TXEIE;
+            usartDMAStart(USART);
+        } else if (tail == st->txHead) {
+            USART->CR1 &= ~USART_CR1_TXEIE;
+        } else {
+            USART->TDR = st->tx[tail & (USART_TX_BUFFER - 1)];
+            st->txTail = tail + 1;
+        }
+    }
+}
+
+void USART1_IRQHandler(void) { usartIRQ(USART1); }
+void USART2_IRQHandler(void) { usartIRQ(USART2); }
+
+void sendChar(USART_TypeDef * USART, char data){
+    usartWriteTimeout(USART, &data, 1, USART_FOREVER);
+}
+
+void sendString(USART_TypeDef * USART, char * charArray){
+    usartWriteTimeout(USART, charArray, strlen(charArray), USART_FOREVER);
 }
 
 char readChar(USART_TypeDef * USART) {
-        char data = USART->RDR;
-        return data;
+    char data;
+    usartReadTimeout(USART, &data, 1, USART_FOREVER);
+    return data;
 }
 
-void readString(USART_TypeDef * USART, char* charArray){
+int readString(USART_TypeDef * USART, char* charArray, int max){
     int i = 0;
-    do{
-        charArray[i] = readChar(USART);
-        i++;
+    if (max <= 0) return 0;
+    if (max > 1) {
+        charArray[i++] = readChar(USART);
+        i += usartRead(USART, &charArray[i], max - 1 - i);
     }
-    while(USART->ISR & USART_ISR_RXNE);
-}
\ No newline at end of file
+    charArray[i] = '\0';
+    return i;
+}
@@ -0,0 +1,177 @@
+// benchmark.c
+// Lab 5 encoder benchmarks: EXTI path cost and TIM2 vs EXTI throughput
+
+#include "main.h"
+#include "benchmark.h"
+
+// Edge rates to sweep, edges/s across both channels
+static const uint32_t benchEncRates[] = {2000, 10000, 50000, 100000, 200000, 400000};
+
+void benchStart(void) {
+  // Benchmarks only use differences, so leave CYCCNT running for micros()/cycles()
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Enable the trace block (DWT)
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;            // Start counting core clocks
+}
+
+// Reference copy of the original updateCount(): the table is rebuilt on the
+// stack each call and the count is a double, i.e. soft-float on the M4
+static volatile int legacyOldState, legacyA, legacyB;
+static volatile double legacyCount;
+
+static void legacyUpdateCount(void) {
+  int QEM [16] = {0,-1,1,2,1,0,2,-1,-1,2,0,1,2,1,-1,0};
+  int index;
+  index = legacyOldState * 4 + (legacyA*2) + legacyB;
+
+  legacyCount += QEM[index];
+  legacyOldState = (legacyA*2) + legacyB;
+}
+
+// Reference copy of the original QEA callback around legacyUpdateCount()
+static void legacyEdge(uint32_t idr, void * ctx) {
+  digitalWriteFast(DEBUG_PIN, 1);
+  legacyA = (idr >> gpioPinOffset(QEA_PIN)) & 1;
+  legacyUpdateCount();
+  digitalWriteFast(DEBUG_PIN, 0);
+}
+
+// Raises pin's EXTI line in software BENCH_ITERATIONS times and returns the
+// cycles taken. With a callback attached each write is a full trip through
+// the interrupt: entry, EXTI9_5_IRQHandler's dispatch, the callback, exit.
+static uint32_t benchExtiPath(int pin) {
+  uint32_t line = 1UL << gpioPinOffset(pin);
+  uint32_t start = DWT->CYCCNT;
+
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    EXTI->SWIER1 = line;
+    __DSB(); // The interrupt is taken before the next iteration
+    __ISB();
+  }
+  return DWT->CYCCNT - start;
+}
+
+// Prints one row as average cycles per call with loop overhead removed
+static void benchReport(const char * name, uint32_t cycles, uint32_t overhead) {
+  uint32_t net = (cycles > overhead) ? (cycles - overhead) : 0;
+  printf("%-28s %4lu.%02lu cycles/call\n", name,
+         (unsigned long) (net / BENCH_ITERATIONS),
+         (unsigned long) ((net % BENCH_ITERATIONS) * 100 / BENCH_ITERATIONS));
+}
+
+void benchUpdateCount(void) {
+  uint32_t start, overhead;
+
+  benchStart();
+  printf("updateCount benchmark, %d calls each\n", BENCH_ITERATIONS);
+
+  // Empty loop to subtract from every measurement
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) __asm volatile ("");
+  overhead = DWT->CYCCNT - start;
+
+  // Interrupts off so no edge lands in the timed loops
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) legacyUpdateCount();
+  benchReport("updateCount (double)", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) updateCount();
+  benchReport("updateCount (int32)", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) takeCount();
+  benchReport("takeCount", DWT->CYCCNT - start, overhead);
+
+  __set_PRIMASK(primask);
+
+  // The whole handler path, with the line masked as the loop overhead. Needs
+  // interrupts enabled; a stray encoder edge adds its own trip to the average.
+  detachInterrupt(QEA_PIN);
+  uint32_t path_overhead = benchExtiPath(QEA_PIN);
+  attachInterrupt(QEA_PIN, EXTI_BOTH, legacyEdge, 0);
+  benchReport("EXTI9_5 path (double)", benchExtiPath(QEA_PIN), path_overhead);
+  attachInterrupt(QEA_PIN, EXTI_BOTH, qeaEdge, 0);
+  benchReport("EXTI9_5 path (int32)", benchExtiPath(QEA_PIN), path_overhead);
+  detachInterrupt(QEA_PIN);
+
+  encoderExtiReset();
+}
+
+// TIM15 as the edge source: toggle outputs, one-pulse bursts of BENCH_ENC_PERIODS
+static void benchEncSource(uint32_t edges_per_s) {
+  uint32_t ticks = 2 * SystemCoreClock / edges_per_s; // Core clocks per TIM15 period
+  uint32_t psc_div = (ticks - 1) / 65536 + 1;
+  uint32_t arr = ticks / psc_div - 1;
+
+  RCC->APB2ENR |= RCC_APB2ENR_TIM15EN;
+  TIM15->CR1 = TIM_CR1_OPM;
+  TIM15->PSC = psc_div - 1;
+  TIM15->ARR = arr;
+  TIM15->RCR = BENCH_ENC_PERIODS - 1;
+
+  // OCxM = 0011: toggle on match. Neither compare sits at 0, so a stopped
+  // counter parked at 0 never adds an edge. B trails A by half a period.
+  TIM15->CCMR1 = _VAL2FLD(TIM_CCMR1_OC1M, 0b0011) | _VAL2FLD(TIM_CCMR1_OC2M, 0b0011);
+  TIM15->CCR1 = 1;
+  TIM15->CCR2 = (arr + 1) / 2 + 1;
+  TIM15->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E;
+  TIM15->BDTR = TIM_BDTR_MOE;
+  TIM15->EGR = TIM_EGR_UG; // Load PSC and RCR
+}
+
+// Runs every burst and returns how often the idle loop spun meanwhile
+static uint32_t benchEncBursts(void) {
+  uint32_t spins = 0;
+
+  for (int i = 0; i < BENCH_ENC_BURSTS; i++) {
+    TIM15->CR1 |= TIM_CR1_CEN;
+    while (TIM15->CR1 & TIM_CR1_CEN) spins++;
+  }
+  return spins;
+}
+
+void benchEncoder(void) {
+  int32_t sent = BENCH_ENC_BURSTS * BENCH_ENC_PERIODS * 2;
+
+  benchStart();
+  printf("Encoder benchmark, %ld edges per rate at %lu Hz core clock\n",
+         (long) sent, (unsigned long) SystemCoreClock);
+  printf("%8s %8s %8s %8s %6s %10s\n", "edges/s", "sent", "TIM2", "EXTI", "load", "cyc/edge");
+
+  for (int r = 0; r < (int) (sizeof(benchEncRates) / sizeof(benchEncRates[0])); r++) {
+    uint32_t rate = benchEncRates[r];
+    benchEncSource(rate);
+
+    // Hardware only: the spin count with nothing to steal the CPU
+    detachInterrupt(QEA_PIN);
+    detachInterrupt(QEB_PIN);
+    int64_t start = encoderPosition();
+    uint32_t spins_idle = benchEncBursts();
+    int64_t hw_edges = encoderPosition() - start;
+
+    // Same stream with the EXTI callbacks counting it as well
+    encoderExtiReset();
+    attachInterrupt(QEA_PIN, EXTI_BOTH, qeaEdge, 0);
+    attachInterrupt(QEB_PIN, EXTI_BOTH, qebEdge, 0);
+    uint32_t t0 = DWT->CYCCNT;
+    uint32_t spins_exti = benchEncBursts();
+    uint32_t elapsed = DWT->CYCCNT - t0;
+    detachInterrupt(QEA_PIN);
+    detachInterrupt(QEB_PIN);
+    int32_t exti_edges = takeCount();
+
+    // Share of the burst time the EXTI path took, in 0.1 %, and its cost per edge
+    uint32_t lost = (spins_exti < spins_idle) ? spins_idle - spins_exti : 0;
+    uint32_t load = spins_idle ? (uint32_t) ((uint64_t) lost * 1000 / spins_idle) : 0;
+    uint32_t per_edge = (uint32_t) ((uint64_t) elapsed * load / 1000 / sent);
+
+    printf("%8lu %8ld %8ld %8ld %4lu.%lu%% %10lu\n", (unsigned long) rate, (long) sent,
+           (long) hw_edges, (long) exti_edges, (unsigned long) (load / 10),
+           (unsigned long) (load % 10), (unsigned long) per_edge);
+  }
+
+  TIM15->CCER = 0;
+}
@@ -0,0 +1,56 @@
+// benchmark.h
+// Header for the Lab 5 encoder benchmarks
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_ITERATIONS 1000 // Calls timed per benchUpdateCount() entry
+
+// Simulated encoder: TIM15 CH1 (PA2) and CH2 (PA3) toggle a quarter period
+// apart, i.e. a quadrature pair with one edge every half TIM15 period. Each
+// burst is one-pulse mode with RCR = BENCH_ENC_PERIODS - 1, so it stops on
+// its own after exactly 2 * BENCH_ENC_PERIODS edges.
+// Unplug the encoder and jumper PA2 -> PA0 and PA6 (A), PA3 -> PA1 and PA8 (B).
+#define BENCH_ENC_PERIODS 256 // TIM15 periods per burst, at most 256
+#define BENCH_ENC_BURSTS  20  // Bursts per rate
+
+#define BENCH_ENC_PINMUX \
+  {PA2, GPIO_ALT, 14, GPIO_SPEED_MEDIUM, GPIO_FLOATING, "Benchmark"}, \
+  {PA3, GPIO_ALT, 14, GPIO_SPEED_MEDIUM, GPIO_FLOATING, "Benchmark"}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Starts the DWT cycle counter (CYCCNT) if the debugger hasn't already. */
+void benchStart(void);
+
+/* Times the EXTI path's updateCount() against a reference copy of the
+ * original (stack-built table, double count) with DWT->CYCCNT and prints
+ * cycles per call, along with takeCount(). Then times the whole interrupt
+ * path for one QEA edge (entry, EXTI9_5 dispatch, callback, exit) with each
+ * version, raising the line through EXTI->SWIER1. Interrupts must be
+ * enabled. The QEA callback is left detached and the software count reset.
+ *
+ * Expected at 80 MHz, counted from the code rather than read off a board:
+ *   updateCount    ~130 cycles (double) -> ~10 (int32)
+ *   EXTI9_5 path   ~200 cycles (double) -> ~75 (int32), of which ~22 are
+ *                  exception entry and exit */
+void benchUpdateCount(void);
+
+/* Feeds the same edge stream to the TIM2 encoder and to the EXTI path at a
+ * sweep of edge rates and prints, per rate, the edges sent, the edges each
+ * path counted and the CPU time the EXTI path took. The load is how much
+ * less a spin loop gets done with the EXTI callbacks attached than without.
+ * initEncoder() must have run and BENCH_ENC_PINMUX be in the pin-mux table.
+ * The EXTI callbacks are left detached afterwards. */
+void benchEncoder(void);
+
+#endif // BENCHMARK_H
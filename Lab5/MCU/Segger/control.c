@@ -0,0 +1,121 @@
+// control.c
+// Closed-loop motor speed control on the encoder velocity estimate
+
+#include "control.h"
+
+static PID controlPID;
+static volatile int controlRunning;
+static volatile int32_t controlSetpoint;
+static volatile int32_t controlOut;
+
+static volatile ControlStats controlTiming;
+static uint32_t controlLastStart; // CYCCNT at the previous step, 0 before the first
+
+// Signed duty to PWM compare and direction pin
+static void controlDrive(int32_t duty) {
+  uint32_t magnitude = (duty < 0) ? -duty : duty;
+
+  digitalWriteFast(CONTROL_DIR_PIN, duty < 0);
+  CONTROL_PWM_TIM->CCR3 = (uint32_t) (((uint64_t) magnitude * (CONTROL_PWM_TIM->ARR + 1)) / CONTROL_DUTY_ONE);
+  controlOut = duty;
+}
+
+static void controlTime(uint32_t start, uint32_t end, uint32_t latency) {
+  uint32_t exec = end - start;
+
+  if (controlTiming.samples == 0) {
+    controlTiming.periodMin = controlTiming.latencyMin = controlTiming.execMin = UINT32_MAX;
+    controlTiming.periodMax = controlTiming.latencyMax = controlTiming.execMax = 0;
+    controlTiming.execSum = 0;
+  }
+  if (controlLastStart) {
+    uint32_t period = start - controlLastStart;
+    if (period < controlTiming.periodMin) controlTiming.periodMin = period;
+    if (period > controlTiming.periodMax) controlTiming.periodMax = period;
+  }
+  if (latency < controlTiming.latencyMin) controlTiming.latencyMin = latency;
+  if (latency > controlTiming.latencyMax) controlTiming.latencyMax = latency;
+  if (exec < controlTiming.execMin) controlTiming.execMin = exec;
+  if (exec > controlTiming.execMax) controlTiming.execMax = exec;
+  controlTiming.execSum += exec;
+  controlTiming.samples++;
+  controlLastStart = start;
+}
+
+// Velocity update hook: one PID step per estimate
+static void controlStep(void) {
+  uint32_t start = DWT->CYCCNT;
+
+  if (controlRunning) controlDrive(pidUpdate(&controlPID, controlSetpoint, velocity()));
+
+  // The loop timer counts up from its update event, so its count is the
+  // time from the ideal sample instant to the new output
+  uint32_t latency = VELOCITY_TIM->CNT * (VELOCITY_TIM->PSC + 1);
+  controlTime(start, DWT->CYCCNT, latency);
+}
+
+void initControl(Capture * cap, uint32_t rate_hz, int32_t kp, int32_t ki, int32_t kd) {
+  // PWM mode 1 on CH3 with preload, 0 % duty
+  RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
+  CONTROL_PWM_TIM->CR1 = TIM_CR1_ARPE;
+  CONTROL_PWM_TIM->PSC = 0;
+  CONTROL_PWM_TIM->ARR = SystemCoreClock / CONTROL_PWM_HZ - 1;
+  CONTROL_PWM_TIM->CCR3 = 0;
+  CONTROL_PWM_TIM->CCMR2 = _VAL2FLD(TIM_CCMR2_OC3M, 0b0110) | TIM_CCMR2_OC3PE;
+  CONTROL_PWM_TIM->CCER |= TIM_CCER_CC3E;
+  CONTROL_PWM_TIM->BDTR |= TIM_BDTR_MOE;
+  CONTROL_PWM_TIM->EGR = TIM_EGR_UG;
+  CONTROL_PWM_TIM->CR1 |= TIM_CR1_CEN;
+
+  pidInit(&controlPID, kp, ki, kd, rate_hz, -CONTROL_DUTY_ONE, CONTROL_DUTY_ONE);
+  controlRunning = 0;
+  controlSetpoint = 0;
+  controlDrive(0);
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  controlTiming.samples = 0;
+  controlLastStart = 0;
+
+  initVelocity(cap, rate_hz, VELOCITY_FILTER);
+  velocityOnUpdate(controlStep);
+}
+
+void controlSetSpeed(int32_t speed) {
+  controlSetpoint = speed;
+  if (!controlRunning) {
+    // Start the integral from scratch rather than from the last run
+    NVIC_DisableIRQ(TIM7_IRQn);
+    pidReset(&controlPID);
+    controlRunning = 1;
+    NVIC_EnableIRQ(TIM7_IRQn);
+  }
+}
+
+void controlStop(void) {
+  NVIC_DisableIRQ(TIM7_IRQn);
+  controlRunning = 0;
+  controlDrive(0);
+  NVIC_EnableIRQ(TIM7_IRQn);
+}
+
+int32_t controlDuty(void) {
+  return controlOut;
+}
+
+void controlStats(ControlStats * stats, int reset) {
+  NVIC_DisableIRQ(TIM7_IRQn);
+  stats->samples    = controlTiming.samples;
+  stats->periodMin  = controlTiming.periodMin;
+  stats->periodMax  = controlTiming.periodMax;
+  stats->latencyMin = controlTiming.latencyMin;
+  stats->latencyMax = controlTiming.latencyMax;
+  stats->execMin    = controlTiming.execMin;
+  stats->execMax    = controlTiming.execMax;
+  stats->execSum    = controlTiming.execSum;
+  if (reset) {
+    controlTiming.samples = 0;
+    controlLastStart = 0;
+  }
+  NVIC_EnableIRQ(TIM7_IRQn);
+}
@@ -0,0 +1,73 @@
+// control.h
+// Closed-loop motor speed control on the encoder velocity estimate
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdint.h>
+#include "STM32L432KC.h"
+#include "pid.h"
+#include "velocity.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Drive for a sign-magnitude H-bridge (e.g. PWM/DIR inputs): TIM1 CH3 PWM
+// on PA10 sets the magnitude, PB0 the direction.
+#define CONTROL_PWM_TIM TIM1
+#define CONTROL_PWM_HZ  20000
+#define CONTROL_DIR_PIN PB0
+
+#define CONTROL_PINMUX \
+  {PA10, GPIO_ALT,    1, GPIO_SPEED_MEDIUM, GPIO_FLOATING, "Control"}, \
+  {PB0,  GPIO_OUTPUT, 0, GPIO_SPEED_LOW,    GPIO_FLOATING, "Control"}
+
+// Controller output: duty in 1/CONTROL_DUTY_ONE of full scale, negative
+// reverses. The input is velocity() in counts/s << VELOCITY_Q.
+#define CONTROL_DUTY_ONE 65536
+
+// PID gain from duty fraction per count/s, the units ../tools/motorsim.c uses
+#define CONTROL_GAIN(g) PID_GAIN((g) * CONTROL_DUTY_ONE / (1 << VELOCITY_Q))
+
+// Loop timing, in core clock cycles. The spread of the period is the
+// jitter; latency runs from the loop timer's update event (the ideal sample
+// instant) to the new PWM compare, so it covers interrupt entry and the
+// velocity update as well.
+typedef struct {
+  uint32_t samples;
+  uint32_t periodMin;  // Between the starts of consecutive control steps
+  uint32_t periodMax;
+  uint32_t latencyMin;
+  uint32_t latencyMax;
+  uint32_t execMin;    // PID step and output
+  uint32_t execMax;
+  uint64_t execSum;
+} ControlStats;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Starts the PWM output at 0 and the control loop on the velocity
+ * estimator's update interrupt, at rate_hz (1-10 kHz). initEncoder() must
+ * have run and CONTROL_PINMUX be in the pin-mux table.
+ *    -- cap: the encoder A capture, passed on to initVelocity()
+ *    -- rate_hz: loop rate
+ *    -- kp, ki, kd: PID gains, e.g. CONTROL_GAIN(1.5e-4) */
+void initControl(Capture * cap, uint32_t rate_hz, int32_t kp, int32_t ki, int32_t kd);
+
+/* Sets the speed setpoint in counts/s << VELOCITY_Q and closes the loop. */
+void controlSetSpeed(int32_t speed);
+
+/* Opens the loop: output 0, PID state cleared. */
+void controlStop(void);
+
+/* Last output, -CONTROL_DUTY_ONE to CONTROL_DUTY_ONE. */
+int32_t controlDuty(void);
+
+/* Copies the loop timing since the last reset.
+ *    -- reset: 1 to start a new measurement afterwards */
+void controlStats(ControlStats * stats, int reset);
+
+#endif // CONTROL_H
@@ -4,14 +4,24 @@
 // 10/31/22
 
 #include "main.h"
+#include "velocity.h"
+#include "control.h"
 
 // State bits
 volatile int oldState = 0;
 volatile int A = 0;
 volatile int B = 0;
 
-// revolutions count
-volatile double count = 0;
+// Encoder counts since the last takeCount(). Integer, so the ISR never
+// touches the (single-precision only) FPU or soft-float double routines.
+static volatile int32_t count = 0;
+
+// Count change indexed by old state * 4 + new state, state = A * 2 + B.
+// 2 marks a skipped state (both bits changed), counted as two steps forward.
+static const int8_t QEM[16] = {0,-1,1,2,1,0,2,-1,-1,2,0,1,2,1,-1,0};
+
+// QEA edge timestamps, for speed from the latest period
+Capture qeaCapture;
 
 /*
 Counts the number of pulses sent out by the encoder
@@ -19,12 +29,37 @@ Counts the number of pulses sent out by the encoder
 Used by the EXTI9_5_IRQHandler function to update based on interupts 
 */
 void updateCount(void){
-    int QEM [16] = {0,-1,1,2,1,0,2,-1,-1,2,0,1,2,1,-1,0};
-    int index;
-    index = oldState * 4 +  (A*2) + B;
+    int state = (A << 1) | B;
+
+    count += QEM[(oldState << 2) | state];
+    oldState = state;
+}
+
+/*
+Returns the count since the last call and zeroes it in one atomic exchange.
+An edge interrupt between LDREX and STREX clears the exclusive monitor on
+exception entry, so the STREX fails and the exchange retries with its count
+included: nothing is lost between reading and zeroing.
+*/
+int32_t takeCount(void){
+    int32_t taken;
 
-    count += QEM[index];
-    oldState = (A*2) + B;
+    do {
+        taken = (int32_t) __LDREXW((volatile uint32_t *) &count);
+    } while (__STREXW(0, (volatile uint32_t *) &count));
+
+    return taken;
+}
+
+/*
+Clears the software count and resyncs the state bits with the pins, e.g.
+before attaching the EXTI callbacks
+*/
+void encoderExtiReset(void){
+    takeCount();
+    A = digitalRead(QEA_PIN);
+    B = digitalRead(QEB_PIN);
+    oldState = (A << 1) | B;
 }
 
 int _write(int file, char *ptr, int len) {
@@ -36,85 +71,118 @@ int _write(int file, char *ptr, int len) {
 }
 
 /*
-External Interrupt Handler.
-
-Triggered by GPIO pins PA6 and PA8 on rising and falling edge of each.
+Encoder edge callbacks, run by the EXTI dispatcher on rising and falling
+edges of PA6 (QEA) and PA8 (QEB).
 
-Global Variables A and B can only be used by this handler.
+idr is GPIOA->IDR sampled on interrupt entry. Global variables A and B can
+only be written by these callbacks.
 */
-void EXTI9_5_IRQHandler(void)
+void qeaEdge(uint32_t idr, void * ctx)
 {
-    digitalWrite(PA9, 1);
-    if (EXTI->PR1 & (1 << 6)) {  // Check line 6
-        EXTI->PR1 = (1 << 6);    // Clear pending bit
-        
-        A = digitalRead(QEA_PIN);
-        updateCount();
-    }
-
-    if (EXTI->PR1 & (1 << 8)) {  // Check line 8
-        EXTI->PR1 = (1 << 8);    // Clear pending bit
-        B = digitalRead(QEB_PIN);
-        updateCount();
-    }
+    digitalWriteFast(DEBUG_PIN, 1);
+    A = (idr >> gpioPinOffset(QEA_PIN)) & 1;
+    updateCount();
+    digitalWriteFast(DEBUG_PIN, 0);
+}
 
-    digitalWrite(PA9,0);
+void qebEdge(uint32_t idr, void * ctx)
+{
+    digitalWriteFast(DEBUG_PIN, 1);
+    B = (idr >> gpioPinOffset(QEB_PIN)) & 1;
+    updateCount();
+    digitalWriteFast(DEBUG_PIN, 0);
 }
 
+// Board pin-mux table: encoder inputs with pull-ups and the ISR timing pin
+const PinMux boardPins[] = {
+    ENCODER_PINMUX,                                                       // PA0, PA1 on TIM2
+    {QEA_PIN,   GPIO_ALT,   14, GPIO_SPEED_LOW, GPIO_PULL_UP,  "Encoder"}, // PA6, TIM16 CH1 (EXTI still sees it)
+    {QEB_PIN,   GPIO_INPUT,  0, GPIO_SPEED_LOW, GPIO_PULL_UP,  "Encoder"}, // PA8
+    {DEBUG_PIN, GPIO_OUTPUT, 0, GPIO_SPEED_LOW, GPIO_FLOATING, "Debug"},
+#if BENCH_ENCODER
+    BENCH_ENC_PINMUX,                                                     // PA2, PA3 from TIM15
+#endif
+#if CONTROL_MOTOR
+    CONTROL_PINMUX,                                                       // PA10 PWM, PB0 direction
+#endif
+};
+
 int main(void) {
     configureFlash();
-    //Enable gpio banks
-    gpioEnable(GPIO_PORT_A);
-
-    // Enable QEA as input
-    pinMode(QEA_PIN, GPIO_INPUT); //USE PA6
-    GPIOA->PUPDR &= ~_VAL2FLD(GPIO_PUPDR_PUPD6, 0b11);
-    GPIOA->PUPDR |=  _VAL2FLD(GPIO_PUPDR_PUPD6, 0b01);
-
-    // Enable QEB as input
-    pinMode(QEB_PIN, GPIO_INPUT); // USE PA8
-    GPIOA->PUPDR &= ~_VAL2FLD(GPIO_PUPDR_PUPD8, 0b11);
-    GPIOA->PUPDR |=  _VAL2FLD(GPIO_PUPDR_PUPD8, 0b01);
+
+    // Enable GPIO bank and set up encoder and debug pins. On a conflict the
+    // rows are printed and no pin is touched, so there is nothing safe to run.
+    if (pinMuxInit(boardPins, PINMUX_COUNT(boardPins)) != 0) {
+        while(1);
+    }
     
     // Initialize values
-    count = 0;
-    A = (GPIOA->IDR & (1U << 6)) ? 1 : 0;
-    B = (GPIOA->IDR & (1U << 8)) ? 1 : 0;
-    oldState = (A << 1) | B;
+    encoderExtiReset();
 
     // Initialize timer
-    RCC->APB1ENR1 |= RCC_APB1ENR1_TIM2EN;
+    RCC->APB1ENR1 |= RCC_APB1ENR1_TIM6EN;
     initTIM(DELAY_TIM);
 
-    // 1. Enable SYSCFG clock domain in RCC
-    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
-    // 2. Configure EXTICR for the input button interrupt
-    SYSCFG->EXTICR[2] |= (_VAL2FLD(SYSCFG_EXTICR2_EXTI6, 0b000)); // Select PA6
-    SYSCFG->EXTICR[3] |= (_VAL2FLD(SYSCFG_EXTICR3_EXTI8, 0b000)); // Select PA8
+    // Hardware quadrature count on TIM2 (PA0/PA1)
+    initEncoder();
 
     // Enable interrupts globally
     __enable_irq();
 
-    // Enable QEA and QEB as intrupts
-    int pins[] = {6, 8};
-    for (int i = 0; i < 2; i++) {
-        int pin = pins[i];
-        EXTI->IMR1  |= (1 << pin);
-        EXTI->RTSR1 |= (1 << pin);
-        EXTI->FTSR1 |= (1 << pin);
-    }
-    
-  
-    // Turn on EXTI interrupt in NVIC_ISER
-    EXTI->PR1 = (0b11111 << 5); //clear flags
-    NVIC_EnableIRQ(EXTI9_5_IRQn);
-    
-
+    // Millisecond tick: delay_millis() now sleeps instead of spinning on TIM2
+    initTick();
+
+#if BENCH_ENCODER
+    benchUpdateCount();
+    benchEncoder();
+#endif
+
+#if ENCODER_EXTI
+    // Interrupt on both edges of QEA and QEB (shares the EXTI9_5 vector)
+    attachInterrupt(QEA_PIN, EXTI_BOTH, qeaEdge, 0);
+    attachInterrupt(QEB_PIN, EXTI_BOTH, qebEdge, 0);
+#endif
+
+    // Period of QEA rising edges on TIM16 CH1
+    initCapture(&qeaCapture, CAPTURE_TIM, 1, CAPTURE_RISING, QEA_PIN);
+
+#if CONTROL_MOTOR
+    // Speed estimate and PID step together at CONTROL_RATE_HZ
+    initControl(&qeaCapture, CONTROL_RATE_HZ, CONTROL_GAIN(CONTROL_KP),
+                CONTROL_GAIN(CONTROL_KI), CONTROL_GAIN(CONTROL_KD));
+    int32_t step = (int32_t) (CONTROL_STEP_RPS * ENCODER_PPR * 4) << VELOCITY_Q;
+    int prints = 0;
+#else
+    // Speed at VELOCITY_RATE_HZ from QEA periods when slow, TIM2 counts when fast
+    initVelocity(&qeaCapture, VELOCITY_RATE_HZ, VELOCITY_FILTER);
+#endif
+
+    int64_t last = encoderPosition();
     while(1){   
-        delay_millis(TIM2, 500);
-        float revs_per_sec = count / (0.5 * (408*4));
-        printf("Revs/s: %.2f, count: %.1f \n", revs_per_sec, count);
-        count = 0;
+        delay_millis(DELAY_TIM, 500);
+        int64_t position = encoderPosition();
+        int32_t delta = (int32_t) (position - last);
+        last = position;
+        float window_rps = delta / (0.5 * (ENCODER_PPR*4));
+        float revs_per_sec = velocity() / (float) ((ENCODER_PPR*4) << VELOCITY_Q);
+
+        printf("Revs/s: %.3f (%s), 500 ms window: %.2f, count: %ld \n", revs_per_sec,
+               (velocityMode() == VELOCITY_COUNT) ? "count" : "period", window_rps, (long) delta);
+#if CONTROL_MOTOR
+        // Setpoint square wave: 2 s at CONTROL_STEP_RPS, 2 s at 0
+        ControlStats stats;
+        controlStats(&stats, 1);
+        printf("Duty: %ld/%d, period %lu-%lu cycles, latency %lu-%lu, PID step %lu avg %lu max \n",
+               (long) controlDuty(), CONTROL_DUTY_ONE, (unsigned long) stats.periodMin,
+               (unsigned long) stats.periodMax, (unsigned long) stats.latencyMin,
+               (unsigned long) stats.latencyMax,
+               (unsigned long) (stats.samples ? stats.execSum / stats.samples : 0),
+               (unsigned long) stats.execMax);
+        if (prints++ % 4 == 0) controlSetSpeed((prints % 8 == 1) ? step : 0);
+#endif
+#if ENCODER_EXTI
+        printf("EXTI count: %ld \n", (long) takeCount());
+#endif
     }
 
 }
\ No newline at end of file
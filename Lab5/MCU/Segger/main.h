@@ -7,16 +7,39 @@
 #define MAIN_H
 
 #include "STM32L432KC.h"
+#include "benchmark.h"
 #include <stm32l432xx.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 // Custom defines
 ///////////////////////////////////////////////////////////////////////////////
 
+// Wiring: encoder A to PA0 (TIM2 CH1) and PA6, B to PA1 (TIM2 CH2) and PA8.
+// TIM2 counts the encoder in hardware; PA6 times the A period on TIM16 and
+// PA6/PA8 feed the per-edge EXTI path when ENCODER_EXTI is on.
 #define QEA_PIN PA6
 #define QEB_PIN PA8
-#define DELAY_TIM TIM2
+#define DEBUG_PIN PA9 // Driven high while EXTI9_5_IRQHandler runs
+#define DELAY_TIM TIM6  // TIM2 belongs to the encoder
+#define ENCODER_EXTI 0  // 1: also count in software on every edge and print both
+#define BENCH_ENCODER 0 // 1: run benchUpdateCount() and benchEncoder() at startup (see benchmark.h)
+#define ENCODER_PPR 408     // QEA pulses per revolution
+#define CAPTURE_TIM TIM16   // Times QEA rising edges on PA6 (TIM16 CH1)
+
+// Speed loop (control.h for the motor driver wiring). Gains are duty per
+// count/s, tuned with ../tools/motorsim.c for a motor that runs 10 rev/s at
+// full duty with a 50 ms time constant.
+#define CONTROL_MOTOR 0     // 1: close the loop and step the setpoint every 2 s
+#define CONTROL_RATE_HZ 2000
+#define CONTROL_KP 1.53e-4
+#define CONTROL_KI 3.06e-3
+#define CONTROL_KD 0
+#define CONTROL_STEP_RPS 5
 
 void updateCount(void);
+int32_t takeCount(void);
+void encoderExtiReset(void);
+void qeaEdge(uint32_t idr, void * ctx);
+void qebEdge(uint32_t idr, void * ctx);
 
 #endif // MAIN_H
\ No newline at end of file
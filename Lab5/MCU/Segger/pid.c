@@ -0,0 +1,46 @@
+// pid.c
+// Fixed-point PID controller with anti-windup
+
+#include "pid.h"
+
+static int64_t pidClamp(int64_t x, int64_t lo, int64_t hi) {
+  return (x < lo) ? lo : (x > hi) ? hi : x;
+}
+
+void pidInit(PID * pid, int32_t kp, int32_t ki, int32_t kd, uint32_t rate_hz,
+             int32_t out_min, int32_t out_max) {
+  pid->kp = kp;
+  pid->ki = ki;
+  pid->kd = kd;
+  pid->rate = rate_hz;
+  pid->outMin = out_min;
+  pid->outMax = out_max;
+  pidReset(pid);
+}
+
+void pidReset(PID * pid) {
+  pid->integral = 0;
+  pid->lastInput = 0;
+  pid->primed = 0;
+}
+
+int32_t pidUpdate(PID * pid, int32_t setpoint, int32_t input) {
+  int64_t error = (int64_t) setpoint - input;
+  int64_t lo = (int64_t) pid->outMin << PID_Q;
+  int64_t hi = (int64_t) pid->outMax << PID_Q;
+
+  // Derivative of the input rather than the error: no kick on setpoint steps
+  int64_t d = 0;
+  if (pid->primed) d = -(int64_t) pid->kd * ((int64_t) input - pid->lastInput) * pid->rate;
+  pid->lastInput = input;
+  pid->primed = 1;
+
+  int64_t p = (int64_t) pid->kp * error;
+  int64_t integral = pidClamp(pid->integral + (int64_t) pid->ki * error / pid->rate, lo, hi);
+  int64_t out = p + integral + d;
+
+  // Anti-windup: keep the new integral unless it pushes further into saturation
+  if (!((out > hi && error > 0) || (out < lo && error < 0))) pid->integral = integral;
+
+  return (int32_t) (pidClamp(p + pid->integral + d, lo, hi) >> PID_Q);
+}
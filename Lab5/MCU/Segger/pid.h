@@ -0,0 +1,51 @@
+// pid.h
+// Fixed-point PID controller with anti-windup
+//
+// No hardware access, so the same file builds into the host motor
+// simulation (../tools/motorsim.c).
+
+#ifndef PID_H
+#define PID_H
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Gains are Q16: output units per input unit (kp), per input unit * s (ki)
+// and per input unit / s (kd). PID_GAIN() converts a constant.
+#define PID_Q 16
+#define PID_GAIN(x) ((int32_t) ((x) * (1 << PID_Q)))
+
+// Controller state. Fields are private to pid.c.
+typedef struct {
+  int32_t  kp, ki, kd;
+  uint32_t rate;       // Updates per second
+  int32_t  outMin, outMax;
+  int64_t  integral;   // Integral term, output units << PID_Q
+  int32_t  lastInput;  // For the derivative, which acts on the input only
+  int      primed;     // lastInput is valid
+} PID;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Sets the gains, update rate and output range, and resets the state. */
+void pidInit(PID * pid, int32_t kp, int32_t ki, int32_t kd, uint32_t rate_hz,
+             int32_t out_min, int32_t out_max);
+
+/* Clears the integral and derivative history, e.g. when the loop is
+ * switched back on. */
+void pidReset(PID * pid);
+
+/* One update at the configured rate. The integral stops growing while the
+ * output is saturated in the direction of the error (conditional
+ * integration) and is clamped to the output range, so a long saturation
+ * doesn't wind it up.
+ *    -- setpoint, input: same units, e.g. counts/s << VELOCITY_Q
+ *    -- return: output, within [out_min, out_max] */
+int32_t pidUpdate(PID * pid, int32_t setpoint, int32_t input);
+
+#endif // PID_H
@@ -0,0 +1,122 @@
+// velocity.c
+// Hybrid period/count encoder velocity estimator
+
+#include "velocity.h"
+
+static struct {
+  Capture *        cap;
+  uint32_t         rate;                 // Updates per second
+  int              filter;
+  int              mode;
+  int              sign;                 // Direction of the last count change
+  int64_t          pos[VELOCITY_WINDOW]; // Positions at the last updates
+  int              slot;                 // pos[] entry of the last update
+  uint32_t         edges;                // captureEdges() at the last update
+  uint64_t         edgeTime;             // Newest A edge at the last update
+  volatile int32_t raw;
+  volatile int32_t filtered;
+  void          (* hook)(void);          // Runs after each update
+} vel;
+
+// 4 * lines counts in ticks of the capture timer, as counts/s << VELOCITY_Q
+static int32_t velPeriod(uint32_t lines, uint64_t ticks) {
+  uint64_t v = (((uint64_t) 4 * lines * SystemCoreClock) << VELOCITY_Q) / ticks;
+  return (v > (INT32_MAX >> 1)) ? (INT32_MAX >> 1) : (int32_t) v;
+}
+
+static void velUpdate(void) {
+  int64_t pos = encoderPosition();
+  int next = (vel.slot + 1) % VELOCITY_WINDOW;
+  int32_t step = (int32_t) (pos - vel.pos[vel.slot]);
+  int64_t oldest = vel.pos[next];
+  int32_t raw;
+
+  vel.pos[next] = pos;
+  vel.slot = next;
+  if (step > 0) vel.sign = 1;
+  if (step < 0) vel.sign = -1;
+
+  if (step < 0) step = -step;
+  if (vel.mode == VELOCITY_PERIOD && step >= VELOCITY_COUNT_HI) vel.mode = VELOCITY_COUNT;
+  if (vel.mode == VELOCITY_COUNT && step < VELOCITY_COUNT_LO) vel.mode = VELOCITY_PERIOD;
+
+  // Track the A edges in both modes so period mode resumes with a fresh base
+  captureUpdate(vel.cap);
+  uint32_t edges = captureEdges(vel.cap);
+  uint64_t edge_time = captureLastEdge(vel.cap);
+  uint32_t lines = edges - vel.edges;
+  int had_edge = (vel.edges != 0);
+  vel.edges = edges;
+
+  if (vel.mode == VELOCITY_COUNT) {
+    raw = (int32_t) (((pos - oldest) * (int64_t) vel.rate * (1 << VELOCITY_Q)) / VELOCITY_WINDOW);
+  } else if (lines && had_edge) {
+    raw = vel.sign * velPeriod(lines, edge_time - vel.edgeTime);
+  } else if (lines) {
+    // First edges since start: only the period between them is known
+    uint64_t period = capturePeriod(vel.cap);
+    raw = period ? vel.sign * velPeriod(1, period) : 0;
+  } else {
+    // No new edge: at most one line in the time since the last one
+    uint64_t since = captureNow(vel.cap->TIMx) - edge_time;
+    int32_t bound = since ? velPeriod(1, since) : 0;
+
+    raw = vel.raw;
+    if (!had_edge || since > (uint64_t) SystemCoreClock * VELOCITY_STOPPED_MS / 1000) raw = 0;
+    else if (raw > bound) raw = bound;
+    else if (raw < -bound) raw = -bound;
+  }
+  vel.edgeTime = edge_time;
+
+  // Low-pass; a step that shifts to nothing lands on the target, so the
+  // output settles exactly instead of one LSB short
+  int32_t move = (raw - vel.filtered) >> vel.filter;
+  vel.raw = raw;
+  vel.filtered = move ? vel.filtered + move : raw;
+
+  if (vel.hook) vel.hook();
+}
+
+void initVelocity(Capture * cap, uint32_t rate_hz, int filter) {
+  RCC->APB1ENR1 |= RCC_APB1ENR1_TIM7EN;
+  VELOCITY_TIM->DIER &= ~TIM_DIER_UIE;
+
+  vel.cap = cap;
+  vel.rate = rate_hz;
+  vel.filter = filter;
+  vel.mode = VELOCITY_PERIOD;
+  vel.sign = 1;
+  vel.slot = 0;
+  for (int i = 0; i < VELOCITY_WINDOW; i++) vel.pos[i] = encoderPosition();
+  captureUpdate(cap);
+  vel.edges = captureEdges(cap);
+  vel.edgeTime = captureLastEdge(cap);
+  vel.raw = vel.filtered = 0;
+
+  initTIMRate(VELOCITY_TIM, rate_hz);
+  VELOCITY_TIM->SR = ~TIM_SR_UIF;
+  VELOCITY_TIM->DIER |= TIM_DIER_UIE;
+  NVIC_EnableIRQ(TIM7_IRQn);
+}
+
+void velocityOnUpdate(void (*hook)(void)) {
+  vel.hook = hook;
+}
+
+int32_t velocity(void) {
+  return vel.filtered;
+}
+
+int32_t velocityRaw(void) {
+  return vel.raw;
+}
+
+int velocityMode(void) {
+  return vel.mode;
+}
+
+void TIM7_IRQHandler(void) {
+  if (!(VELOCITY_TIM->SR & TIM_SR_UIF)) return;
+  VELOCITY_TIM->SR = ~TIM_SR_UIF;
+  velUpdate();
+}
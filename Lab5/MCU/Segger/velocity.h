@@ -0,0 +1,63 @@
+// velocity.h
+// Hybrid period/count encoder velocity estimator
+
+#ifndef VELOCITY_H
+#define VELOCITY_H
+
+#include <stdint.h>
+#include "STM32L432KC.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Velocities are encoder counts/s (4 per line) in fixed point with
+// VELOCITY_Q fraction bits, e.g. 256 = 1 count/s.
+#define VELOCITY_Q 8
+
+#define VELOCITY_TIM       TIM7  // Update interrupt runs the estimator
+#define VELOCITY_RATE_HZ   1000  // Default update rate
+#define VELOCITY_FILTER    2     // Default low-pass: y += (x - y) >> 2, 0 = off
+#define VELOCITY_STOPPED_MS 200  // No A edge for this long reads as 0
+
+// Period mode (slow): N rising A edges since the last update, over the time
+// between the newest edge now and the newest edge last update (M/T method).
+// With no new edge the speed decays as 1 line / time since the last edge.
+// Count mode (fast): TIM2 position change over the last VELOCITY_WINDOW
+// updates. Period mode hands over once the counts per update reach
+// VELOCITY_COUNT_HI, before the capture ring (CAPTURE_RING edges) can
+// overflow between updates, and takes back below VELOCITY_COUNT_LO.
+#define VELOCITY_WINDOW   8  // Updates per count-mode window, a power of 2
+#define VELOCITY_COUNT_HI 32 // Counts per update, 8 A edges
+#define VELOCITY_COUNT_LO 16
+
+// Values of velocityMode()
+#define VELOCITY_PERIOD 0
+#define VELOCITY_COUNT  1
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Starts estimating on VELOCITY_TIM's update interrupt. initEncoder() must
+ * have run and cap must capture the rising edges of encoder A.
+ *    -- cap: the A channel capture
+ *    -- rate_hz: updates per second, e.g. VELOCITY_RATE_HZ
+ *    -- filter: low-pass shift, 0 (off) to 8; each update moves the output
+ *               1/2^filter of the way to the raw estimate */
+void initVelocity(Capture * cap, uint32_t rate_hz, int filter);
+
+/* Runs hook from the update interrupt right after each new estimate, e.g. a
+ * control loop locked to the estimator's rate. 0 removes it. */
+void velocityOnUpdate(void (*hook)(void));
+
+/* Filtered velocity as of the last update, counts/s << VELOCITY_Q. */
+int32_t velocity(void);
+
+/* Unfiltered velocity as of the last update, counts/s << VELOCITY_Q. */
+int32_t velocityRaw(void);
+
+/* VELOCITY_PERIOD or VELOCITY_COUNT, the method the last update used. */
+int velocityMode(void);
+
+#endif // VELOCITY_H
@@ -0,0 +1,153 @@
+// motorsim.c
+// Host simulation of the Lab 5 speed loop: the firmware's pid.c against a
+// first-order motor model, at each loop rate with and without timing jitter.
+// Each row is checked against the limits below; exits 1 if any row fails.
+//
+// build: cc -O2 -I../Segger -o motorsim motorsim.c ../Segger/pid.c -lm
+// usage: motorsim [-K counts_per_s] [-t tau_ms] [-p kp] [-i ki] [-d kd] [-s step_rps] [-j jitter_us]
+//
+// Gains are in the firmware's units (duty fraction per count/s, see main.h);
+// the defaults match CONTROL_KP/KI/KD there.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pid.h"
+
+#define ENCODER_PPR      408
+#define VELOCITY_Q       8      // velocity.h
+#define VELOCITY_FILTER  2
+#define CONTROL_DUTY_ONE 65536  // control.h
+#define PWM_STEPS        200    // TIM1 ARR + 1 at 4 MHz / 20 kHz
+#define SIM_DT           1e-6   // Model time step, s
+
+// Pass limits, for the default motor and gains
+#define LIMIT_RISE       0.080  // Step rise time, s
+#define LIMIT_OVERSHOOT  5.0    // Step overshoot, % of the step
+#define LIMIT_SETTLE     0.200  // Step settling time, s
+#define LIMIT_ERROR      0.1    // Steady-state error, % of the setpoint
+#define LIMIT_WINDUP     5.0    // Overshoot after a stall, % of the setpoint
+#define LIMIT_RECOVER    0.200  // Settling time after a stall, s
+
+static double motorK = 16320;   // No-load speed at full duty, counts/s (10 rev/s)
+static double motorTau = 0.050; // Mechanical time constant, s
+static double gainP = 1.53e-4, gainI = 3.06e-3, gainD = 0;
+static double stepRps = 5;
+static double jitterUs = 50;
+
+typedef struct {
+  double rise;      // 10-90 %, s
+  double overshoot; // % of the step
+  double settle;    // Last time outside 2 % of the setpoint, s
+  double error;     // Mean error over the last 10 %, % of the setpoint
+} Response;
+
+// Firmware gain for a duty fraction per count/s
+static int32_t simGain(double g) {
+  return PID_GAIN(g * CONTROL_DUTY_ONE / (1 << VELOCITY_Q));
+}
+
+// Runs a 0 -> setpoint step for length seconds. With stall, the shaft is held
+// still for the first half (saturating the output the whole time) and let go
+// for the second, and the response is measured from the release.
+static Response simulate(unsigned rate, double jitter_s, double length, int stall) {
+  PID pid;
+  Response r = {0, 0, 0, 0};
+  double setpoint = stepRps * ENCODER_PPR * 4;
+  double w = 0, u = 0, u_next = 0, t = 0;
+  double next_sample = 0, apply_at = -1;
+  double t10 = -1, t90 = -1, peak = 0, err_sum = 0;
+  long err_n = 0;
+  int32_t filtered = 0;
+
+  pidInit(&pid, simGain(gainP), simGain(gainI), simGain(gainD), rate, -CONTROL_DUTY_ONE, CONTROL_DUTY_ONE);
+  srand(1);
+
+  for (long n = 0; t < length; n++) {
+    t = n * SIM_DT;
+    double t0 = stall ? length / 2 : 0;
+
+    // Loop timer tick: sample now, output after the interrupt latency
+    if (t >= next_sample) {
+      int32_t raw = (int32_t) lround(w * (1 << VELOCITY_Q));
+      int32_t move = (raw - filtered) >> VELOCITY_FILTER;
+      filtered = move ? filtered + move : raw;
+
+      int32_t duty = pidUpdate(&pid, (int32_t) lround(setpoint * (1 << VELOCITY_Q)), filtered);
+      long steps = lround(fabs((double) duty) * PWM_STEPS / CONTROL_DUTY_ONE);
+      u_next = (duty < 0 ? -1.0 : 1.0) * steps / PWM_STEPS;
+      apply_at = t + jitter_s * rand() / RAND_MAX;
+      next_sample += 1.0 / rate;
+    }
+    if (apply_at >= 0 && t >= apply_at) {
+      u = u_next;
+      apply_at = -1;
+    }
+
+    w = (t < t0) ? 0 : w + (motorK * u - w) / motorTau * SIM_DT;
+
+    // Measure from the step or the release
+    if (t < t0) continue;
+    if (t10 < 0 && w >= 0.1 * setpoint) t10 = t;
+    if (t90 < 0 && w >= 0.9 * setpoint) t90 = t;
+    if (w > peak) peak = w;
+    if (fabs(w - setpoint) > 0.02 * setpoint) r.settle = t - t0;
+    if (t > length * 0.9) {
+      err_sum += setpoint - w;
+      err_n++;
+    }
+  }
+
+  r.rise = (t10 >= 0 && t90 >= 0) ? t90 - t10 : -1;
+  r.overshoot = peak > setpoint ? 100 * (peak - setpoint) / setpoint : 0;
+  r.error = err_n ? 100 * err_sum / err_n / setpoint : 0;
+  return r;
+}
+
+int main(int argc, char ** argv) {
+  static const unsigned rates[] = {1000, 2000, 5000, 10000};
+  int failed = 0;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    double v = atof(argv[i + 1]);
+    if (!strcmp(argv[i], "-K")) motorK = v;
+    else if (!strcmp(argv[i], "-t")) motorTau = v / 1000;
+    else if (!strcmp(argv[i], "-p")) gainP = v;
+    else if (!strcmp(argv[i], "-i")) gainI = v;
+    else if (!strcmp(argv[i], "-d")) gainD = v;
+    else if (!strcmp(argv[i], "-s")) stepRps = v;
+    else if (!strcmp(argv[i], "-j")) jitterUs = v;
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  printf("Motor: %.0f counts/s at full duty, tau %.0f ms. Step 0 -> %.2f rev/s.\n",
+         motorK, motorTau * 1000, stepRps);
+  printf("Gains: kp %.3g, ki %.3g, kd %.3g (duty per count/s)\n\n", gainP, gainI, gainD);
+  printf("%6s %9s %9s %10s %10s %9s %10s %10s  %s\n", "rate", "jitter", "rise ms", "overshoot",
+         "settle ms", "error", "stall over", "recover ms", "result");
+
+  for (int i = 0; i < (int) (sizeof(rates) / sizeof(rates[0])); i++) {
+    for (int j = 0; j < 2; j++) {
+      double jitter = j ? jitterUs * 1e-6 : 0;
+      Response step = simulate(rates[i], jitter, 0.5, 0);
+      Response stall = simulate(rates[i], jitter, 1.0, 1);
+
+      // A stall saturates the output for half a second; with anti-windup the
+      // release looks like a fresh step instead of overshooting
+      int ok = step.rise >= 0 && step.rise <= LIMIT_RISE && step.overshoot <= LIMIT_OVERSHOOT &&
+               step.settle <= LIMIT_SETTLE && fabs(step.error) <= LIMIT_ERROR &&
+               stall.overshoot <= LIMIT_WINDUP && stall.settle <= LIMIT_RECOVER;
+      failed |= !ok;
+
+      printf("%6u %6.0f us %9.2f %9.2f%% %10.2f %8.3f%% %9.2f%% %10.2f  %s\n", rates[i], jitter * 1e6,
+             step.rise * 1000, step.overshoot, step.settle * 1000, step.error, stall.overshoot,
+             stall.settle * 1000, ok ? "ok" : "FAIL");
+    }
+  }
+  return failed;
+}
@@ -10,10 +10,13 @@
    In more detail:
 
    1) The webserver starts a 125000 baud serial connection over the hardware UART (for debug)
-   2) The webserver connects to a given network or creates its own.
-   3) The webserver waits for a request from the client. When it receives one, it transmits /REQ:<path>\n to the MCU. 
+   2) The webserver steps the link up to the fastest rate in linkRates[] that both ends can
+      reach and that passes a ping test (see negotiateBaud()).
+   3) The webserver connects to a given network or creates its own.
+   4) The webserver waits for a request from the client. When it receives one, it transmits /REQ:<path>\n to the MCU. 
 
-   Step 3 is repeated while the program runs
+   Step 4 is repeated while the program runs. After LINK_FAIL_LIMIT pages in a row fail,
+   the link drops back to 125000 baud and steps up again, below the rate that failed.
 
    Connecting to ESP:
 
@@ -26,6 +29,29 @@
 #define mcuSerial Serial
 #define AP_MODE true
 
+// MCU link rates. The ESP's UART divides 80 MHz by a whole number, so rates
+// it can't make within LINK_TOLERANCE ppm (3 Mbaud is 2.6 % fast) are skipped.
+#define LINK_BASE_BAUD  125000
+#define LINK_TOLERANCE  15000  // Each end's share of what an 8N1 receiver tolerates
+#define LINK_REPLY_MS   50
+#define LINK_TRIAL_MS   200    // The MCU undoes a rate not kept by then
+#define LINK_PROBES     8      // /PING round trips a new rate must pass
+#define LINK_FAIL_LIMIT 3      // Failed pages in a row before falling back
+
+// RTS/CTS to the MCU, matching LINK_FLOW in the MCU's main.h. Off by
+// default: it needs two wires beyond TX/RX,
+//   GPIO13 (U0CTS) <- PA12 (USART1 RTS)
+//   GPIO15 (U0RTS) -> PA11 (USART1 CTS)
+// Turned on without them, GPIO13 floats and transmit can stall. RTS goes high
+// once the RX FIFO holds LINK_RTS_LEVEL of its 128 bytes, so a burst pauses
+// instead of overrunning it while the UART interrupt is held off.
+#define LINK_FLOW       false
+#define LINK_RTS_LEVEL  112
+#define PAGE_TIMEOUT_MS 200    // Silence that ends a page with no </html>: the MCU is gone
+const unsigned long linkRates[] = {1000000, 2000000, 3000000, 4000000};
+unsigned long linkMax = 4000000; // Highest rate to try, lowered by fallbacks
+int           linkFailures = 0;
+
 // defining start and end HTML tags
 const String htmlStart = "<!DOCTYPE html><html>";
 const String htmlEnd = "</html>";
@@ -82,6 +108,91 @@ int substringInString(String haystack, String needle) {
   return false;
 }
 
+// Turns on the UART0 hardware flow control the Arduino core leaves off.
+// Serial.begin() rewrites USC0, so this runs after it.
+void linkFlowControl() {
+  pinMode(13, FUNCTION_4); // U0CTS
+  pinMode(15, FUNCTION_4); // U0RTS
+  USC1(UART0) = (USC1(UART0) & ~(0x7F << UCRXHWTH)) | (LINK_RTS_LEVEL << UCRXHWTH) | (1 << UCRXHWFE);
+  USC0(UART0) |= (1 << UCTXHWFE);
+}
+
+// Reads one line from the MCU, or "" after timeout_ms
+String linkReadLine(unsigned long timeout_ms) {
+  String line = "";
+  unsigned long start = millis();
+  while (millis() - start < timeout_ms) {
+    if (mcuSerial.available()) {
+      char c = mcuSerial.read();
+      line.concat(c);
+      if (c == '\n') return line;
+    } else {
+      yield();
+    }
+  }
+  return "";
+}
+
+// Rate error of the ESP's UART at baud, in ppm
+long linkError(unsigned long baud) {
+  unsigned long actual = ESP8266_CLOCK / (ESP8266_CLOCK / baud);
+  return (long) (((long long) actual - (long long) baud) * 1000000 / baud);
+}
+
+// Returns both ends to LINK_BASE_BAUD: zeros at the base rate arrive as
+// framing errors at any faster one, and enough of them make the MCU fall back
+void linkReset() {
+  mcuSerial.updateBaudRate(LINK_BASE_BAUD);
+  for (int i = 0; i < 8; i++) mcuSerial.write((uint8_t) 0);
+  mcuSerial.write('\n'); // Ends the zeros as a line the MCU drops
+  mcuSerial.flush();
+  delay(LINK_TRIAL_MS);
+  while (mcuSerial.available()) mcuSerial.read();
+}
+
+// Tries one rate: asks the MCU over the current one, switches, and keeps it
+// if every probe comes back intact. Returns true if the link now runs at baud.
+bool linkTry(unsigned long baud) {
+  unsigned long old = mcuSerial.baudRate();
+
+  while (mcuSerial.available()) mcuSerial.read();
+  mcuSerial.print("/BAUD:" + String(baud) + "\n");
+  if (linkReadLine(LINK_REPLY_MS) != "/BAUD:OK\n") return false;
+
+  mcuSerial.updateBaudRate(baud);
+  delay(1);
+  for (int i = 0; i < LINK_PROBES; i++) {
+    // 'U' toggles every bit, '~' and '0' hold long runs
+    String ping = String(i) + ":UUUU~~~~0000zzzz\n";
+    mcuSerial.print("/PING:" + ping);
+    if (linkReadLine(LINK_REPLY_MS) != "/PONG:" + ping) {
+      // The MCU goes back by itself once the trial times out
+      mcuSerial.updateBaudRate(old);
+      delay(LINK_TRIAL_MS * 2);
+      while (mcuSerial.available()) mcuSerial.read();
+      return false;
+    }
+  }
+  mcuSerial.print("/BAUD:KEEP\n");
+  if (linkReadLine(LINK_REPLY_MS) != "/BAUD:KEPT\n") {
+    linkReset();
+    return false;
+  }
+  return true;
+}
+
+// Steps the link up through linkRates[] to linkMax, stopping at the first
+// rate that fails
+void negotiateBaud() {
+  for (unsigned int i = 0; i < sizeof(linkRates) / sizeof(linkRates[0]); i++) {
+    unsigned long baud = linkRates[i];
+    if (baud > linkMax) break;
+    if (labs(linkError(baud)) > LINK_TOLERANCE) continue;
+    if (!linkTry(baud)) break;
+  }
+  linkFailures = 0;
+}
+
 // Sends parsedRequest over UART to the MCU and waits for a complete webpage to be returned
 String receiveWebPage(String parsedRequestIn, WiFiClient * webClient) {
   String webpage = ""; //clear webpage in preparation for new webpage to be transmitted
@@ -105,8 +216,18 @@ String receiveWebPage(String parsedRequestIn, WiFiClient * webClient) {
       lastByteTime = millis();
     }
 
-    // Print the output to the browser if a </html> was sent or the system times out
-    if ((webpage.indexOf("</html>") != -1) || (millis() > lastByteTime + 200)) {
+    // Print the output to the browser if a </html> was sent or the system times out.
+    // With flow control the MCU only pauses while the ESP is behind, so the
+    // timeout is for a dead link, not the end of a page.
+    if ((webpage.indexOf("</html>") != -1) || (millis() - lastByteTime > PAGE_TIMEOUT_MS)) {
+      if (webpage.indexOf("</html>") != -1) {
+        linkFailures = 0;
+      } else if (++linkFailures >= LINK_FAIL_LIMIT && mcuSerial.baudRate() != LINK_BASE_BAUD) {
+        // Too many broken pages: start again below the rate that failed
+        linkMax = mcuSerial.baudRate() - 1;
+        linkReset();
+        negotiateBaud();
+      }
       if (webpage.length() < 10) {
         webpage = "Could not connect to the MCU. Please check your connections. (10 or fewer bytes were received from the processor.)";
       }
@@ -125,8 +246,15 @@ String receiveWebPage(String parsedRequestIn, WiFiClient * webClient) {
 
 //Setup code. Runs once on program execution before loop code
 void setup() {
-  // initalize the MCU serial connection
-  mcuSerial.begin(125000);
+  // initalize the MCU serial connection. A page arrives in a few ms at
+  // Mbaud rates, faster than loop() may read it, so buffer all of it.
+  mcuSerial.setRxBufferSize(4096);
+  mcuSerial.begin(LINK_BASE_BAUD);
+  if (LINK_FLOW) linkFlowControl();
+
+  // The MCU may still be at a rate from before the ESP reset
+  linkReset();
+  negotiateBaud();
 
   // Initialize the wifi according to the requested mode
   if (AP_MODE) {
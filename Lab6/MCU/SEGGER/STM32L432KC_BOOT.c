@@ -0,0 +1,78 @@
+// STM32L432KC_BOOT.c
+// Source code for boot-time profiling
+
+#include <stdio.h>
+#include "STM32L432KC_BOOT.h"
+#include "STM32L432KC_DWT.h"
+
+// Written by Reset_Handler before .bss is cleared, so it must live outside .bss
+uint32_t bootSystemInitCycles __attribute__((section(".non_init")));
+
+static const char * const bootPhaseNames[BOOT_PHASES] = {
+  "SystemInit", "data/bss init", "configureFlash", "PLL lock", "peripheral init", "first request"
+};
+
+static struct {
+  int      phase;
+  uint64_t cycles; // cycles() at the end of the phase
+  uint32_t hz;     // SystemCoreClock at the end of the phase
+} bootMarks[BOOT_MARKS];
+static int bootMarkCount = 0;
+
+// cycles() at reset (Reset_Handler zeroes CYCCNT) or at the first mark
+static uint64_t bootStartCycles = 0;
+
+void bootMark(int phase) {
+#ifndef __BOOT_PROFILE
+  if (bootMarkCount == 0) {
+    // Reset_Handler didn't start the counter, so count from the first mark.
+    // CYCCNT keeps running for its other users.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    bootStartCycles = cycles();
+    bootSystemInitCycles = 0;
+  }
+#endif
+  if (bootMarkCount == BOOT_MARKS) return;
+
+  bootMarks[bootMarkCount].cycles = cycles() - bootStartCycles;
+  bootMarks[bootMarkCount].phase = phase;
+  bootMarks[bootMarkCount].hz = SystemCoreClock;
+  bootMarkCount++;
+}
+
+static uint32_t bootMicros(uint64_t cycles, uint32_t hz) {
+  return (uint32_t) ((cycles / hz) * 1000000 + (cycles % hz) * 1000000 / hz);
+}
+
+uint32_t bootReport(uint32_t budget_us) {
+  uint64_t prev_cycles = bootSystemInitCycles;
+  uint32_t prev_hz = BOOT_RESET_HZ;
+  uint32_t total_us = bootMicros(bootSystemInitCycles, BOOT_RESET_HZ);
+
+  printf("Boot profile (cycles, us)\n");
+  printf("  %-16s %9lu %8lu\n", bootPhaseNames[BOOT_SYSTEMINIT],
+         (unsigned long) bootSystemInitCycles, (unsigned long) total_us);
+
+  for (int i = 0; i < bootMarkCount; i++) {
+    // A phase runs at the clock left by the one before it, e.g. PLL lock runs on MSI
+    uint64_t cycles = bootMarks[i].cycles - prev_cycles;
+    uint32_t us = bootMicros(cycles, prev_hz);
+    int phase = bootMarks[i].phase;
+
+    printf("  %-16s %9llu %8lu\n", (phase >= 0 && phase < BOOT_PHASES) ? bootPhaseNames[phase] : "?",
+           (unsigned long long) cycles, (unsigned long) us);
+
+    total_us += us;
+    prev_cycles = bootMarks[i].cycles;
+    prev_hz = bootMarks[i].hz;
+  }
+
+  if (budget_us) {
+    printf("  total %lu us of %lu us budget%s\n", (unsigned long) total_us, (unsigned long) budget_us,
+           (total_us > budget_us) ? " -- OVER BUDGET" : "");
+  } else {
+    printf("  total %lu us\n", (unsigned long) total_us);
+  }
+  return total_us;
+}
@@ -0,0 +1,265 @@
+// STM32L432KC_CAPTURE.c
+// Source code for the input-capture period/frequency/duty driver
+
+#include "STM32L432KC_CAPTURE.h"
+#include "STM32L432KC_DMA.h"
+#include "STM32L432KC_GPIO.h"
+
+#define CAPTURE_TIMERS 3
+
+// Per-timer state: the wrap count and the channels drained on each wrap
+static struct {
+  TIM_TypeDef *     TIMx;
+  IRQn_Type         irq;
+  uint32_t          mask;      // Counter range, 0xFFFF or 0xFFFFFFFF
+  int               shift;     // Counter width in bits
+  volatile uint32_t overflows;
+  Capture *         chans[4];
+} capTimers[CAPTURE_TIMERS] = {
+  {TIM2,  TIM2_IRQn,            0xFFFFFFFF, 32, 0, {0}},
+  {TIM15, TIM1_BRK_TIM15_IRQn,  0xFFFF,     16, 0, {0}},
+  {TIM16, TIM1_UP_TIM16_IRQn,   0xFFFF,     16, 0, {0}},
+};
+
+static int capTimerIndex(TIM_TypeDef * TIMx) {
+  for (int i = 0; i < CAPTURE_TIMERS; i++) {
+    if (capTimers[i].TIMx == TIMx) return i;
+  }
+  return -1;
+}
+
+// DMA1 channel and request for a timer channel (RM Table 41), 0 if none
+static int capDMAChannel(TIM_TypeDef * TIMx, int channel, int * request) {
+  static const int tim2Chan[4] = {5, 7, 1, 7};
+  static const int tim2Req[4] = {DMA_REQ_TIM2_CH1, DMA_REQ_TIM2_CH2, DMA_REQ_TIM2_CH3, DMA_REQ_TIM2_CH4};
+
+  if (TIMx == TIM2) {
+    *request = tim2Req[channel - 1];
+    return tim2Chan[channel - 1];
+  }
+  if (TIMx == TIM15 && channel == 1) {
+    *request = DMA_REQ_TIM15_CH1;
+    return 5;
+  }
+  if (TIMx == TIM16 && channel == 1) {
+    *request = DMA_REQ_TIM16_CH1;
+    return 6;
+  }
+  return 0;
+}
+
+// Extended count with interrupts off. A wrap the update interrupt hasn't
+// counted yet shows as a pending UIF with a small count.
+static uint64_t capNow(int t) {
+  TIM_TypeDef * TIMx = capTimers[t].TIMx;
+  uint32_t cnt = TIMx->CNT & capTimers[t].mask;
+  uint64_t overflows = capTimers[t].overflows;
+
+  if ((TIMx->SR & TIM_SR_UIF) && cnt < (capTimers[t].mask >> 1)) overflows++;
+  return (overflows << capTimers[t].shift) | cnt;
+}
+
+// Extends every edge the DMA wrote since the last drain (captureRingDrain()).
+// The update interrupt drains on every wrap, so every edge is drained within
+// one counter period; only an edge landing within that interrupt's latency
+// jitter of the previous drain could come out a wrap late.
+static void capDrain(Capture * cap, uint64_t now) {
+  int t = capTimerIndex(cap->TIMx);
+  uint32_t ndtr, level = 0;
+
+  // With both edges, the pin sits at the level the newest edge left it.
+  // Sample it while no edge is written so the two agree.
+  do {
+    ndtr = cap->dma->CNDTR;
+    if (cap->edges == CAPTURE_BOTH) level = digitalRead(cap->pin);
+  } while (cap->dma->CNDTR != ndtr);
+
+  captureRingDrain(&cap->stamps, (CAPTURE_RING - ndtr) % CAPTURE_RING, now, capTimers[t].mask);
+  cap->rising = (cap->edges == CAPTURE_BOTH) ? level : (cap->edges == CAPTURE_RISING);
+}
+
+// Half or full transfer: drain before the DMA laps the ring
+static void capDMAIRQ(void * ctx) {
+  Capture * cap = ctx;
+
+  dmaClearFlags(DMA1, cap->dmaNum, DMA_FLAG_GIF);
+  captureUpdate(cap);
+}
+
+int initCapture(Capture * cap, TIM_TypeDef * TIMx, int channel, int edges, int pin) {
+  int t = capTimerIndex(TIMx);
+  int request;
+  int dma_channel = (t < 0 || channel < 1 || channel > 4) ? 0 : capDMAChannel(TIMx, channel, &request);
+  int shift = 4 * (channel - 1);
+
+  if (dma_channel == 0) return -1;
+
+  // Another capture on the same DMA channel, e.g. TIM2 CH2 and CH4
+  for (int i = 0; i < CAPTURE_TIMERS; i++) {
+    for (int j = 0; j < 4; j++) {
+      Capture * other = capTimers[i].chans[j];
+      if (other && other != cap && other->dma == dmaChannel(DMA1, dma_channel)) return -1;
+    }
+  }
+  if (dmaClaim(DMA1, dma_channel, "Capture", capDMAIRQ, cap) < 0) return -1; // e.g. WAVE or a USART
+
+  cap->TIMx = TIMx;
+  cap->channel = channel;
+  cap->edges = edges;
+  cap->pin = pin;
+  cap->dma = dmaChannel(DMA1, dma_channel);
+  cap->dmaNum = dma_channel;
+  cap->rising = 0;
+
+  // First channel on this timer: free-run it at the core clock
+  if (!(TIMx->DIER & TIM_DIER_UIE)) {
+    if (TIMx == TIM2)  RCC->APB1ENR1 |= RCC_APB1ENR1_TIM2EN;
+    if (TIMx == TIM15) RCC->APB2ENR  |= RCC_APB2ENR_TIM15EN;
+    if (TIMx == TIM16) RCC->APB2ENR  |= RCC_APB2ENR_TIM16EN;
+
+    TIMx->CR1 &= ~TIM_CR1_CEN;
+    TIMx->PSC = 0;
+    TIMx->ARR = capTimers[t].mask;
+    TIMx->CR1 |= TIM_CR1_URS;  // Only real wraps raise UIF, not UG
+    TIMx->EGR = TIM_EGR_UG;
+    TIMx->SR = ~TIM_SR_UIF;
+    capTimers[t].overflows = 0;
+    TIMx->DIER |= TIM_DIER_UIE;
+    NVIC_EnableIRQ(capTimers[t].irq);
+    TIMx->CR1 |= TIM_CR1_CEN;
+  }
+
+  // Peripheral -> ring, circular, interrupting every half ring to drain it
+  initDMAChannel(DMA1, dma_channel, request);
+  cap->dma->CPAR  = (uint32_t) (&TIMx->CCR1 + (channel - 1));
+  cap->dma->CMAR  = (uint32_t) cap->stamps.ring;
+  cap->dma->CNDTR = CAPTURE_RING;
+  cap->dma->CCR   = _VAL2FLD(DMA_CCR_MSIZE, 0b10) | _VAL2FLD(DMA_CCR_PSIZE, 0b10) |
+                    DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+  cap->dma->CCR  |= DMA_CCR_EN;
+  NVIC_EnableIRQ(dmaIRQn(DMA1, dma_channel));
+
+  // CCxS = 01: input capture from TIx, ICxPSC = 0 (every edge), ICxF
+  volatile uint32_t * ccmr = (channel <= 2) ? &TIMx->CCMR1 : &TIMx->CCMR2;
+  int ccmr_shift = 8 * ((channel - 1) % 2);
+  TIMx->CCER &= ~(0xFUL << shift);
+  *ccmr = (*ccmr & ~(0xFFUL << ccmr_shift)) | ((0b01 | (CAPTURE_FILTER << 4)) << ccmr_shift);
+
+  // CCxP/CCxNP: 00 rising, 01 falling, 11 both
+  uint32_t polarity = (edges == CAPTURE_RISING) ? 0 : (edges == CAPTURE_FALLING) ? TIM_CCER_CC1P
+                                                                                : (TIM_CCER_CC1P | TIM_CCER_CC1NP);
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  capTimers[t].chans[channel - 1] = cap;
+  captureRingInit(&cap->stamps, capNow(t));
+  TIMx->DIER |= (TIM_DIER_CC1DE << (channel - 1));
+  TIMx->CCER |= (polarity | TIM_CCER_CC1E) << shift;
+  __set_PRIMASK(primask);
+
+  return 0;
+}
+
+// captureUpdate() with interrupts already off
+static void capUpdate(Capture * cap) {
+  capDrain(cap, capNow(capTimerIndex(cap->TIMx)));
+}
+
+void captureUpdate(Capture * cap) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  capUpdate(cap);
+  __set_PRIMASK(primask);
+}
+
+uint64_t capturePeriod(Capture * cap) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  capUpdate(cap);
+  uint64_t period = captureRingPeriod(&cap->stamps, cap->edges == CAPTURE_BOTH);
+  __set_PRIMASK(primask);
+  return period;
+}
+
+uint32_t capturePeriodNs(Capture * cap) {
+  return (uint32_t) (capturePeriod(cap) * 1000000000ULL / SystemCoreClock);
+}
+
+uint32_t captureFrequency(Capture * cap) {
+  uint64_t period = capturePeriod(cap);
+  return period ? (uint32_t) (((uint64_t) SystemCoreClock * 1000 + period / 2) / period) : 0;
+}
+
+uint32_t captureDuty(Capture * cap) {
+  uint64_t period, high;
+  uint32_t primask = __get_PRIMASK();
+
+  if (cap->edges != CAPTURE_BOTH) return 0;
+
+  __disable_irq();
+  capUpdate(cap);
+  const uint64_t * edge = cap->stamps.edge;
+  period = captureRingPeriod(&cap->stamps, 1);
+  // Newest edge falling: it ends the high time. Rising: the one before did.
+  high = cap->rising ? edge[1] - edge[2] : edge[0] - edge[1];
+  __set_PRIMASK(primask);
+
+  return period ? (uint32_t) (high * 10000 / period) : 0;
+}
+
+uint64_t captureSinceEdge(Capture * cap) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint64_t now = capNow(capTimerIndex(cap->TIMx));
+  capDrain(cap, now);
+  uint64_t since = now - cap->stamps.edge[0];
+  __set_PRIMASK(primask);
+  return since;
+}
+
+uint64_t captureLastEdge(Capture * cap) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  capUpdate(cap);
+  uint64_t edge = cap->stamps.edge[0];
+  __set_PRIMASK(primask);
+  return edge;
+}
+
+uint32_t captureEdges(Capture * cap) {
+  captureUpdate(cap);
+  return cap->stamps.count;
+}
+
+uint32_t captureLaps(Capture * cap) {
+  captureUpdate(cap);
+  return cap->stamps.laps;
+}
+
+uint64_t captureNow(TIM_TypeDef * TIMx) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint64_t now = capNow(capTimerIndex(TIMx));
+  __set_PRIMASK(primask);
+  return now;
+}
+
+// Update interrupt: count the wrap, then drain every channel on the timer
+static void capIRQ(int t) {
+  TIM_TypeDef * TIMx = capTimers[t].TIMx;
+
+  if (!(TIMx->SR & TIM_SR_UIF)) return;
+  TIMx->SR = ~TIM_SR_UIF;
+  capTimers[t].overflows++;
+
+  uint64_t now = capNow(t);
+  for (int i = 0; i < 4; i++) {
+    if (capTimers[t].chans[i]) capDrain(capTimers[t].chans[i], now);
+  }
+}
+
+// Weak, so a driver that owns a whole timer (the Lab 5 encoder on TIM2) can
+// take its vector instead
+__WEAK void TIM2_IRQHandler(void)           { capIRQ(0); }
+__WEAK void TIM1_BRK_TIM15_IRQHandler(void) { capIRQ(1); }
+__WEAK void TIM1_UP_TIM16_IRQHandler(void)  { capIRQ(2); }
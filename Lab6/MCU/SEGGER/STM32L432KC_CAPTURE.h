@@ -0,0 +1,101 @@
+// STM32L432KC_CAPTURE.h
+// Header for the input-capture period/frequency/duty driver
+
+#ifndef STM32L4_CAPTURE_H
+#define STM32L4_CAPTURE_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+#include "capring.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// The capturing timer free-runs at the core clock (PSC = 0), so timestamps
+// have 1/SystemCoreClock resolution: 12.5 ns at 80 MHz, 250 ns at 4 MHz.
+// Each edge's CCR value goes into a circular DMA ring of CAPTURE_RING
+// (capring.h); the timer's update interrupt counts wraps and extends the ring
+// entries to 64 bits. The DMA's half and full transfer interrupts drain the
+// ring as well, so edges are only lost if CAPTURE_RING/2 of them come within
+// one interrupt latency; captureLaps() counts those drains.
+#define CAPTURE_FILTER 0  // ICxF: 0 = no filter, 0b0011 = 8 core clocks
+
+// Edges to capture
+#define CAPTURE_RISING  0
+#define CAPTURE_FALLING 1
+#define CAPTURE_BOTH    2 // Needed for captureDuty()
+
+// DMA1 channels (RM Table 41). TIM2 CH2 and CH4 share channel 7, and TIM2
+// CH1 and TIM15 CH1 share channel 5 with the WAVE engine. TIM15 CH2 has no
+// DMA request. TIM16 uses channel 6, leaving channel 3 to the DAC engine.
+//   TIM2  CH1 PA0/PA5/PA15 AF1   TIM15 CH1 PA2 AF14
+//   TIM2  CH2 PA1/PB3 AF1        TIM16 CH1 PA6/PB8 AF14
+//   TIM2  CH3 PA2 AF1
+//   TIM2  CH4 PA3 AF1
+#define TIM16_CH1_PINMUX {PA6, GPIO_ALT, 14, GPIO_SPEED_LOW, GPIO_FLOATING, "CAPTURE"}
+
+// One capture channel. Fields are private to the driver.
+typedef struct {
+  TIM_TypeDef *         TIMx;
+  int                   channel;     // 1-4
+  int                   edges;       // CAPTURE_RISING/FALLING/BOTH
+  int                   pin;         // Input pin, for the edge direction with CAPTURE_BOTH
+  DMA_Channel_TypeDef * dma;
+  int                   dmaNum;      // DMA1 channel number
+  CaptureRing           stamps;      // Raw CCR values, written by DMA, and the extended edges
+  int                   rising;      // stamps.edge[0] was a rising edge
+} Capture;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Starts capturing on a timer channel. The first channel on a timer takes
+ * the timer over: PSC = 0, full-range ARR, update interrupt on. The pin must
+ * already be on the channel's alternate function.
+ *    -- TIMx: TIM2, TIM15 or TIM16
+ *    -- channel: 1-4 (TIM2), 1 (TIM15, TIM16)
+ *    -- edges: CAPTURE_RISING, CAPTURE_FALLING or CAPTURE_BOTH
+ *    -- pin: input pin ID, e.g. PA6
+ *    -- return: 0, or -1 if the channel has no free DMA channel (another capture
+ *               or another driver holds it, see dmaClaim()) */
+int initCapture(Capture * cap, TIM_TypeDef * TIMx, int channel, int edges, int pin);
+
+/* Extends the edges the DMA has written since the last call. Runs from the
+ * timer's update interrupt, the DMA interrupts and every reader below as
+ * well, so calling it is never required. */
+void captureUpdate(Capture * cap);
+
+/* Timer ticks between the two newest like edges (rising to rising with
+ * CAPTURE_BOTH), or 0 until there are two back to back (none lost between). */
+uint64_t capturePeriod(Capture * cap);
+
+/* capturePeriod() in ns. */
+uint32_t capturePeriodNs(Capture * cap);
+
+/* Input frequency in mHz, 0 until there are two edges. */
+uint32_t captureFrequency(Capture * cap);
+
+/* High time over period in 0.01 % (0-10000). CAPTURE_BOTH only, else 0. */
+uint32_t captureDuty(Capture * cap);
+
+/* Timer ticks since the newest edge, or since initCapture() without one.
+ * A slow or stopped input has a period of at least this. */
+uint64_t captureSinceEdge(Capture * cap);
+
+/* Timestamp of the newest edge, on the captureNow() time base, or the time
+ * of initCapture() without one. */
+uint64_t captureLastEdge(Capture * cap);
+
+/* Edges seen since initCapture(). Edges lost to a lap are included as
+ * estimated from the input's period. */
+uint32_t captureEdges(Capture * cap);
+
+/* Drains that found edges lost, see capring.h. */
+uint32_t captureLaps(Capture * cap);
+
+/* The timer's 64-bit extended count, in the same time base as the edges. */
+uint64_t captureNow(TIM_TypeDef * TIMx);
+
+#endif
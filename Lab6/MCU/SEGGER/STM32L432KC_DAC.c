@@ -0,0 +1,102 @@
+// STM32L432KC_DAC.c
+// Source code for the DAC sample-playback audio engine
+
+#include "STM32L432KC_DAC.h"
+#include "STM32L432KC_DMA.h"
+#include "STM32L432KC_DWT.h"
+#include "STM32L432KC_TIM.h"
+
+// Engine state
+static AudioBuffer audio;
+static uint64_t audioCycles; // cycles() at the last service, or at audioStart()
+
+static void audioDMAIRQ(void * ctx);
+
+int audioInit(void * buffer, int samples, int format, AudioRefill refill, void * ctx) {
+  DMA_Channel_TypeDef * ch;
+
+  if (dmaClaim(AUDIO_DMA, AUDIO_DMA_CHANNEL, "DAC1", audioDMAIRQ, 0) < 0) return -1;
+
+  audioBufferInit(&audio, buffer, samples, (format == AUDIO_FORMAT_16BIT) ? 2 : 1, refill, ctx);
+
+  RCC->APB1ENR1 |= RCC_APB1ENR1_TIM6EN | RCC_APB1ENR1_DAC1EN;
+
+  // TIM6 update event -> TRGO -> DAC trigger
+  AUDIO_TIM->CR1 &= ~TIM_CR1_CEN;
+  AUDIO_TIM->CR2 = _VAL2FLD(TIM_CR2_MMS, 0b010);
+
+  // Channel 1: buffered output to PA4, triggered by TIM6 TRGO (TSEL1 = 000),
+  // each trigger requests the next sample over DMA
+  DAC1->CR &= ~DAC_CR_EN1;
+  DAC1->MCR &= ~DAC_MCR_MODE1;
+  DAC1->CR = (DAC1->CR & ~(DAC_CR_TSEL1 | DAC_CR_WAVE1)) | DAC_CR_TEN1 | DAC_CR_DMAEN1 | DAC_CR_DMAUDRIE1;
+
+  initDMAChannel(AUDIO_DMA, AUDIO_DMA_CHANNEL, DMA_REQ_DAC1_CH1);
+  ch = dmaChannel(AUDIO_DMA, AUDIO_DMA_CHANNEL);
+  ch->CPAR = (format == AUDIO_FORMAT_16BIT) ? (uint32_t) &DAC1->DHR12L1 : (uint32_t) &DAC1->DHR8R1;
+  ch->CMAR = (uint32_t) buffer;
+  return 0;
+}
+
+int audioStart(uint32_t rate_hz) {
+  DMA_Channel_TypeDef * ch = dmaChannel(AUDIO_DMA, AUDIO_DMA_CHANNEL);
+  uint32_t size = (audio.bytes == 2) ? 0b01 : 0b00;
+
+  if (rate_hz < AUDIO_RATE_MIN || rate_hz > AUDIO_RATE_MAX) return -1;
+
+  audioBufferPrime(&audio);
+
+  // Memory -> DHR, circular over both halves, interrupt at each half
+  ch->CCR &= ~DMA_CCR_EN;
+  dmaClearFlags(AUDIO_DMA, AUDIO_DMA_CHANNEL, DMA_FLAG_GIF);
+  ch->CNDTR = 2 * audio.samples;
+  ch->CCR   = _VAL2FLD(DMA_CCR_MSIZE, size) | _VAL2FLD(DMA_CCR_PSIZE, size) |
+              DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_DIR | DMA_CCR_HTIE | DMA_CCR_TCIE;
+  ch->CCR  |= DMA_CCR_EN;
+  NVIC_EnableIRQ(dmaIRQn(AUDIO_DMA, AUDIO_DMA_CHANNEL));
+
+  DAC1->SR = DAC_SR_DMAUDR1;
+  DAC1->CR |= DAC_CR_EN1;
+  NVIC_EnableIRQ(TIM6_DAC_IRQn);
+
+  audioCycles = cycles();
+  initTIMRate(AUDIO_TIM, rate_hz);
+  return 0;
+}
+
+void audioStop(void) {
+  AUDIO_TIM->CR1 &= ~TIM_CR1_CEN;
+  dmaChannel(AUDIO_DMA, AUDIO_DMA_CHANNEL)->CCR &= ~DMA_CCR_EN;
+}
+
+uint32_t audioLate(void) {
+  return audio.late;
+}
+
+// Half transfer or transfer complete: the DMA moved into the other half.
+// Its position says where in the buffer it is; the core cycles since the
+// last service over TIM6's cycles per sample say how many laps it made, so
+// flags merged by a late interrupt still count every late half.
+static void audioDMAIRQ(void * ctx) {
+  uint32_t size = 2 * audio.samples;
+
+  dmaClearFlags(AUDIO_DMA, AUDIO_DMA_CHANNEL, DMA_FLAG_GIF);
+
+  uint32_t left = dmaChannel(AUDIO_DMA, AUDIO_DMA_CHANNEL)->CNDTR;
+  uint64_t now = cycles();
+  uint32_t per_sample = (AUDIO_TIM->PSC + 1) * (AUDIO_TIM->ARR + 1);
+
+  audioBufferService(&audio, (int) ((size - left) % size), (uint32_t) ((now - audioCycles) / per_sample));
+  audioCycles = now;
+}
+
+// DAC DMA underrun: a trigger came before the previous request was served.
+// The DAC disables its DMA requests, so re-arm them.
+void TIM6_DAC_IRQHandler(void) {
+  if (DAC1->SR & DAC_SR_DMAUDR1) {
+    DAC1->SR = DAC_SR_DMAUDR1;
+    DAC1->CR &= ~DAC_CR_DMAEN1;
+    DAC1->CR |= DAC_CR_DMAEN1;
+    audioBufferUnderrun(&audio);
+  }
+}
@@ -0,0 +1,75 @@
+// STM32L432KC_DMA.h
+// Header for DMA functions
+
+#ifndef STM32L4_DMA_H
+#define STM32L4_DMA_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Per-channel flags returned by dmaFlags() (see RM 11.6.1 DMA_ISR)
+#define DMA_FLAG_GIF 0b0001 // Global interrupt flag
+#define DMA_FLAG_TC  0b0010 // Transfer complete
+#define DMA_FLAG_HT  0b0100 // Half transfer
+#define DMA_FLAG_TE  0b1000 // Transfer error
+
+// CSELR request numbers (RM Table 41/42). The comment gives the channel.
+#define DMA_REQ_TIM2_CH1  4 // DMA1 channel 5
+#define DMA_REQ_TIM2_CH2  4 // DMA1 channel 7
+#define DMA_REQ_TIM2_CH3  4 // DMA1 channel 1
+#define DMA_REQ_TIM2_CH4  4 // DMA1 channel 7
+#define DMA_REQ_DAC1_CH1  6 // DMA1 channel 3
+#define DMA_REQ_TIM15_UP  7 // DMA1 channel 5
+#define DMA_REQ_TIM15_CH1 7 // DMA1 channel 5
+#define DMA_REQ_TIM16_CH1 4 // DMA1 channel 3 or 6
+#define DMA_REQ_TIM16_UP  4 // DMA1 channel 3 or 6
+#define DMA_REQ_TIM6_UP   6 // DMA1 channel 3 (shared with DAC1_CH1)
+#define DMA_REQ_TIM7_UP   5 // DMA1 channel 4
+#define DMA_REQ_USART1_TX 2 // DMA1 channel 4, DMA2 channel 6
+#define DMA_REQ_USART2_TX 2 // DMA1 channel 7
+#define DMA_REQ_USART1_RX 2 // DMA1 channel 5, DMA2 channel 7
+#define DMA_REQ_USART2_RX 2 // DMA1 channel 6
+
+// Channel interrupt handler, called from the DMA IRQ with the claim's ctx
+typedef void (*DmaHandler)(void * ctx);
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Returns a pointer to a channel's registers.
+ *    -- DMAx: DMA1 or DMA2
+ *    -- channel: 1-7 */
+DMA_Channel_TypeDef * dmaChannel(DMA_TypeDef * DMAx, int channel);
+
+/* Returns the NVIC interrupt number of a channel. */
+IRQn_Type dmaIRQn(DMA_TypeDef * DMAx, int channel);
+
+/* Claims a channel for one driver and routes its interrupt to handler. Every
+ * driver claims its channels before initDMAChannel(), so two drivers can't
+ * share one by accident. Claiming again under the same owner is fine.
+ *    -- owner: driver name, printed on conflicts
+ *    -- handler: interrupt handler, or 0 if the channel never interrupts
+ *    -- return: 0, or -1 (conflict printed, nothing changed) if another
+ *               owner holds the channel */
+int dmaClaim(DMA_TypeDef * DMAx, int channel, const char * owner, DmaHandler handler, void * ctx);
+
+/* Disables a channel and frees it for another driver. */
+void dmaRelease(DMA_TypeDef * DMAx, int channel);
+
+/* Turns on the DMA clock, disables the channel, clears its flags and routes
+ * "request" to it through CSELR. The caller then sets CPAR/CMAR/CNDTR/CCR.
+ *    -- request: a DMA_REQ_* value valid for this channel */
+void initDMAChannel(DMA_TypeDef * DMAx, int channel, int request);
+
+/* Returns the channel's DMA_FLAG_* bits from DMA_ISR. */
+uint32_t dmaFlags(DMA_TypeDef * DMAx, int channel);
+
+/* Clears the given DMA_FLAG_* bits of a channel with one IFCR write. */
+void dmaClearFlags(DMA_TypeDef * DMAx, int channel, uint32_t flags);
+
+#endif
@@ -0,0 +1,49 @@
+// STM32L432KC_DWT.h
+// Header for the 64-bit monotonic clock built on the DWT cycle counter
+
+#ifndef STM32L4_DWT_H
+#define STM32L4_DWT_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// How often the SysTick timer wheel samples CYCCNT so no 32-bit wrap is missed.
+// CYCCNT wraps every 53 s at 80 MHz; the period must stay below that.
+#define DWT_EXTEND_MS 10000
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Starts DWT->CYCCNT (without resetting it) and the 64-bit extension.
+ * If initTick() has already run, a periodic timer keeps the extension current;
+ * otherwise cycles()/micros() must be called at least once per CYCCNT wrap. */
+void initDWT(void);
+
+/* Returns the core cycle count (CYCCNT extended to 64 bits). */
+uint64_t cycles(void);
+
+/* Returns microseconds since initDWT(). Each clock change through
+ * clockSetMSI()/clockSetPLL() rebases the conversion, so the count stays
+ * monotonic and calibrated across frequency changes. Before initDWT() it
+ * converts the raw cycle count at the current SystemCoreClock. */
+uint64_t micros(void);
+
+/* Busy-waits us microseconds at the current SystemCoreClock, to within a few
+ * cycles. Use tickDelay() for long waits that can sleep. */
+void delay_micros(uint32_t us);
+
+/* Returns cycles elapsed since a cycles() timestamp. */
+uint64_t elapsedCycles(uint64_t since);
+
+/* Returns microseconds elapsed since a micros() timestamp. */
+uint64_t elapsedMicros(uint64_t since);
+
+/* Converts a cycle count at the current SystemCoreClock to microseconds. */
+uint32_t cyclesToMicros(uint64_t count);
+
+#endif
@@ -31,6 +31,12 @@
 #define GPIO_PULL_DOWN 1 // Arbitrary ID for a pull-down resistor
 #define GPIO_FLOATING  2 // Arbitrary ID for a floating pin (neither resistor is active)
 
+// Output speeds (values match the OSPEEDR field encoding)
+#define GPIO_SPEED_LOW       0
+#define GPIO_SPEED_MEDIUM    1
+#define GPIO_SPEED_HIGH      2
+#define GPIO_SPEED_VERY_HIGH 3
+
 // Pin definitions for every GPIO pin
 #define PA0    0
 #define PA1    1
@@ -81,6 +87,66 @@
 #define PC14   46
 #define PC15   47
 
+///////////////////////////////////////////////////////////////////////////////
+// Fast-path macros
+///////////////////////////////////////////////////////////////////////////////
+
+// GPIOA, GPIOB and GPIOC sit 0x400 apart on AHB2, so a pin ID maps to its port
+// with arithmetic instead of the switch in gpioPortToBase(). When "pin" is a
+// constant (e.g. PA9) the address and mask fold at compile time, even at -O0.
+#define GPIO_PORT_STRIDE     (GPIOB_BASE - GPIOA_BASE)
+#define GPIO_PORT_BASE(port) ((GPIO_TypeDef *) (GPIOA_BASE + (uint32_t) (port) * GPIO_PORT_STRIDE))
+#define GPIO_PIN_BASE(pin)   GPIO_PORT_BASE((uint32_t) (pin) >> 4)
+#define GPIO_PIN_MASK(pin)  (1UL << ((pin) & 0x0F))
+
+// Single-store writes through BSRR/BRR. These do not read ODR, so they cannot
+// clobber a pin that an interrupt changes between the read and the write.
+#define digitalWriteFast(pin, val) \
+  ((val) ? (GPIO_PIN_BASE(pin)->BSRR = GPIO_PIN_MASK(pin)) \
+         : (GPIO_PIN_BASE(pin)->BRR  = GPIO_PIN_MASK(pin)))
+#define digitalSetFast(pin)   (GPIO_PIN_BASE(pin)->BSRR = GPIO_PIN_MASK(pin))
+#define digitalClearFast(pin) (GPIO_PIN_BASE(pin)->BRR  = GPIO_PIN_MASK(pin))
+#define digitalReadFast(pin)  ((GPIO_PIN_BASE(pin)->IDR >> ((pin) & 0x0F)) & 1)
+
+// Toggle by writing the set half of BSRR for a low pin and the reset half for
+// a high pin. Only the pin's own bits are written, so other pins are untouched.
+#define togglePinFast(pin) \
+  (GPIO_PIN_BASE(pin)->BSRR = ((GPIO_PIN_BASE(pin)->ODR & GPIO_PIN_MASK(pin)) << 16) | \
+                              (~GPIO_PIN_BASE(pin)->ODR & GPIO_PIN_MASK(pin)))
+
+///////////////////////////////////////////////////////////////////////////////
+// Pin groups
+///////////////////////////////////////////////////////////////////////////////
+
+// A set of pins on a single port, e.g. keypad rows or a parallel bus.
+// Bit n of "mask" is the pin with gpioPinOffset() == n.
+typedef struct {
+  int      port; // GPIO port ID, e.g. GPIO_PORT_B
+  uint16_t mask; // Pins in the group
+} GPIO_Group;
+
+#define GPIO_GROUP(port, mask) ((GPIO_Group) { (port), (uint16_t) (mask) })
+
+// BSRR word that drives the pins in "mask" to "value": set bits in the low
+// half, reset bits in the high half. Also used to build DMA waveform tables.
+#define GPIO_BSRR_VALUE(mask, value) \
+  ((((uint32_t) ~(value) & (mask)) << 16) | ((uint32_t) (value) & (mask)))
+
+/* Drives every pin in the group with one BSRR store.
+ *    -- group: the pins to write
+ *    -- value: port-aligned bits; pins whose bit is 1 go high, 0 go low.
+ *              Bits outside the group's mask are ignored. */
+static inline void gpioWriteMask(GPIO_Group group, uint32_t value) {
+  GPIO_PORT_BASE(group.port)->BSRR = GPIO_BSRR_VALUE(group.mask, value);
+}
+
+/* Samples every pin in the group with one IDR load.
+ *    -- group: the pins to read
+ *    -- return: port-aligned bits, with bits outside the group's mask cleared */
+static inline uint32_t gpioReadMask(GPIO_Group group) {
+  return GPIO_PORT_BASE(group.port)->IDR & group.mask;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,41 @@
+// STM32L432KC_PINMUX.h
+// Header for the board pin-mux table
+
+#ifndef STM32L4_PINMUX_H
+#define STM32L4_PINMUX_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+#include "STM32L432KC_GPIO.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// One row of the board pin-mux table
+typedef struct {
+  int pin;            // GPIO pin ID, e.g. PB3
+  int mode;           // GPIO_INPUT, GPIO_OUTPUT, GPIO_ALT or GPIO_ANALOG
+  int af;             // Alternate function number (0-15), used with GPIO_ALT
+  int speed;          // GPIO_SPEED_LOW ... GPIO_SPEED_VERY_HIGH
+  int pull;           // GPIO_PULL_UP, GPIO_PULL_DOWN or GPIO_FLOATING
+  const char * owner; // Driver that claims the pin, printed on conflicts
+} PinMux;
+
+#define PINMUX_COUNT(table) ((int) (sizeof(table) / sizeof((table)[0])))
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Programs every pin in the table. The rows are first merged per port, then
+ * each of OSPEEDR, PUPDR, AFR[0], AFR[1] and MODER gets one masked write per
+ * port, and the port clocks get one AHB2ENR write. MODER is written last so a
+ * pin never switches to its alternate function before the AF is selected.
+ *    -- table: the board pin-mux table
+ *    -- count: number of rows, e.g. PINMUX_COUNT(table)
+ *    -- return: number of rows that claim a pin an earlier row already owns.
+ *               If nonzero, the conflicts are printed and nothing is written. */
+int pinMuxInit(const PinMux table[], int count);
+
+#endif
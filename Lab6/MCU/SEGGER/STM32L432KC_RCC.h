@@ -7,11 +7,69 @@
 #include <stdint.h>
 #include <stm32l432xx.h>
 
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// MSI ranges for clockSetMSI() (values match RCC_CR.MSIRANGE)
+#define MSI_RANGE_100KHZ 0
+#define MSI_RANGE_200KHZ 1
+#define MSI_RANGE_400KHZ 2
+#define MSI_RANGE_800KHZ 3
+#define MSI_RANGE_1MHZ   4
+#define MSI_RANGE_2MHZ   5
+#define MSI_RANGE_4MHZ   6 // Reset value and PLL input
+#define MSI_RANGE_8MHZ   7
+#define MSI_RANGE_16MHZ  8
+#define MSI_RANGE_24MHZ  9
+#define MSI_RANGE_32MHZ  10
+#define MSI_RANGE_48MHZ  11
+
+#define CLOCK_LISTENERS 8 // Maximum drivers notified of clock changes
+
+/* Called after every clock change, with SystemCoreClock already updated.
+ *    -- hclk: the new HCLK (= PCLK1 = PCLK2, since APB prescalers are 1)
+ *    -- ctx: the pointer passed to clockAddListener() */
+typedef void (*ClockListener)(uint32_t hclk, void * ctx);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
 
+void startPLL();
 void configurePLL();
 void configureClock();
 
+/* Fast start: starts the 80 MHz PLL without waiting for lock, leaving SYSCLK
+ * on MSI so the peripherals can be initialized during the lock time. */
+void startClockFast();
+
+/* Waits for the PLL started by startClockFast(), switches SYSCLK to it and
+ * re-times the drivers registered with clockAddListener(). */
+void finishClockFast();
+
+/* Runs SYSCLK from MSI at the given range. PLL is turned off.
+ *    -- range: MSI_RANGE_100KHZ ... MSI_RANGE_48MHZ
+ *    -- return: the new SystemCoreClock, or 0 if the range is invalid for
+ *               the current voltage range */
+uint32_t clockSetMSI(int range);
+
+/* Runs SYSCLK from the PLL (4 MHz MSI * N / R) as close to hz as possible.
+ *    -- hz: target frequency, 8-80 MHz
+ *    -- return: the new SystemCoreClock, or 0 if hz is out of range */
+uint32_t clockSetPLL(uint32_t hz);
+
+/* Selects the regulator voltage range. Range 2 saves power but limits HCLK
+ * to 26 MHz.
+ *    -- range: 1 or 2
+ *    -- return: 0 on success, -1 if the current clock is too fast for range */
+int setVoltageRange(int range);
+
+/* Returns the current regulator voltage range (1 or 2). */
+int getVoltageRange(void);
+
+/* Registers a driver to re-time itself after clock changes.
+ *    -- return: 0 on success, -1 if the listener table is full */
+int clockAddListener(ClockListener listener, void * ctx);
+
 #endif
\ No newline at end of file
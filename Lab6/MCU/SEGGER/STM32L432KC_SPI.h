@@ -10,6 +10,16 @@
 #include <stdint.h>
 #include <stm32l432xx.h>
 
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Board pin-mux rows for SPI1 (AF5 on PA1/PA5/PA11, PB3/PB4/PB5 ...)
+#define SPI1_PINMUX(sck, miso, mosi) \
+  {(sck),  GPIO_ALT, 5, GPIO_SPEED_VERY_HIGH, GPIO_FLOATING, "SPI1"}, \
+  {(miso), GPIO_ALT, 5, GPIO_SPEED_LOW,       GPIO_FLOATING, "SPI1"}, \
+  {(mosi), GPIO_ALT, 5, GPIO_SPEED_LOW,       GPIO_FLOATING, "SPI1"}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
@@ -19,7 +29,8 @@
  *    -- cpol: clock polarity (0: inactive state is logical 0, 1: inactive state is logical 1).
  *    -- cpha: clock phase (0: data captured on leading edge of clk and changed on next edge, 
  *          1: data changed on leading edge of clk and captured on next edge)
- * Refer to the datasheet for more low-level details. */ 
+ * Refer to the datasheet for more low-level details.
+ * The SPI pins must already be configured, e.g. with SPI1_PINMUX in the board pin-mux table. */ 
 void initSPI(int br, int cpol, int cpha);
 
 /* Transmits a character (1 byte) over SPI and returns the received character.
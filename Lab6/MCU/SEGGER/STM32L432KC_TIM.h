@@ -14,6 +14,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 void initTIM(TIM_TypeDef * TIMx);
+// Starts TIMx with update events at rate_hz. rate_hz 0 leaves the timer stopped.
+void initTIMRate(TIM_TypeDef * TIMx, uint32_t rate_hz);
+// Waits ms milliseconds: sleeps on the SysTick tick after initTick(), otherwise spins on TIMx
 void delay_millis(TIM_TypeDef * TIMx, uint32_t ms);
 
 #endif
\ No newline at end of file
@@ -49,6 +49,11 @@ Additional information:
         SystemInit is usually supplied by the CMSIS files.
         This file declares a weak implementation as fallback.
 
+    __BOOT_PROFILE
+      If defined,
+        the DWT cycle counter is started on reset and its value after
+        SystemInit is stored in bootSystemInitCycles (STM32L432KC_BOOT.c).
+
     __NO_SYSTEM_CLK_UPDATE
       If defined,
         SystemCoreClockUpdate is not automatically called.
@@ -121,12 +126,39 @@ Reset_Handler:
         ldr     R1, =__SEGGER_STOP_Limit_MSP
         str     R0, [R1]
 #endif
+#ifdef __BOOT_PROFILE
+        //
+        // Start DWT->CYCCNT from 0 so the boot phases can be timed
+        //
+        movw    R0, 0xEDFC         // DEMCR
+        movt    R0, 0xE000
+        ldr     R1, [R0]
+        orr     R1, R1, #(1 << 24) // TRCENA
+        str     R1, [R0]
+        movw    R0, 0x1000         // DWT_CTRL
+        movt    R0, 0xE000
+        movs    R1, #0
+        str     R1, [R0, #4]       // DWT_CYCCNT = 0
+        ldr     R1, [R0]
+        orr     R1, R1, #1         // CYCCNTENA
+        str     R1, [R0]
+#endif
 #ifndef __NO_SYSTEM_INIT
         //
         // Call SystemInit
         //
         bl      SystemInit
 #endif
+#ifdef __BOOT_PROFILE
+        //
+        // Record the end of SystemInit, before .data/.bss are initialized
+        //
+        movw    R0, 0x1004         // DWT_CYCCNT
+        movt    R0, 0xE000
+        ldr     R1, [R0]
+        ldr     R0, =bootSystemInitCycles
+        str     R1, [R0]
+#endif
 #ifdef __MEMORY_INIT
         //
         // Call MemoryInit
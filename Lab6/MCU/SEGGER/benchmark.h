@@ -0,0 +1,46 @@
+// benchmark.h
+// Header for cycle-count benchmarks of the peripheral libraries
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_ITERATIONS 1000 // Operations timed per benchmark entry
+
+// Pin toggled by benchGPIO(). Must be an output that is safe to wiggle.
+#ifndef BENCH_GPIO_PIN
+#define BENCH_GPIO_PIN PB0
+#endif
+
+#define BENCH_STRING_REPS 4 // sendString() calls timed per ART mode, through to the last stop bit
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Starts the DWT cycle counter (CYCCNT) if the debugger hasn't already. */
+void benchStart(void);
+
+/* Times the GPIO write/toggle paths with DWT->CYCCNT and prints the average
+ * cycles per call over printf. Runs on the board or on an emulated STM32L432
+ * (e.g. Renode) since it only touches GPIO and the DWT. */
+void benchGPIO(void);
+
+/* Runs representative kernels under each flash ART accelerator mode (off,
+ * prefetch, I-cache, I+D-cache, all) and prints cycles per call:
+ *   - convertB2D() over a sweep of DS1722 readings
+ *   - one pass of a song() note loop programming TIM16 (without the note delays)
+ *   - sendString() of a short line until it is sent, which is mostly UART-bound
+ * The ART mode in effect on entry is restored afterwards.
+ *    -- USART: an initialized USART for the sendString() kernel, or 0 to skip it.
+ *              The kernel sends a test line on it, so use a port nothing parses
+ *              (e.g. the ST-LINK virtual COM port), not the ESP link. */
+void benchFlash(USART_TypeDef * USART);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,59 @@
+// capring.c
+// Timestamp ring bookkeeping for the input-capture driver
+
+#include "capring.h"
+
+// Extends the edge in slot "read" and moves on
+static void captureRingPush(CaptureRing * r, uint64_t now, uint32_t mask) {
+  uint32_t c = r->ring[r->read];
+
+  r->edge[2] = r->edge[1];
+  r->edge[1] = r->edge[0];
+  r->edge[0] = now - (((uint32_t) now - c) & mask);
+  r->last = c;
+  r->count++;
+  r->run++;
+  r->read = (r->read + 1) % CAPTURE_RING;
+}
+
+void captureRingInit(CaptureRing * r, uint64_t now) {
+  r->read = 0;
+  r->last = r->ring[CAPTURE_RING - 1];
+  r->edge[0] = r->edge[1] = r->edge[2] = now;
+  r->count = 0;
+  r->run = 0;
+  r->laps = 0;
+}
+
+void captureRingDrain(CaptureRing * r, int write, uint64_t now, uint32_t mask) {
+  uint32_t fresh = (write - r->read + CAPTURE_RING) % CAPTURE_RING;
+
+  if (r->ring[(r->read + CAPTURE_RING - 1) % CAPTURE_RING] == r->last) {
+    while (r->read != write) captureRingPush(r, now, mask);
+    return;
+  }
+
+  // Lapped: every slot is newer than the last drain, the oldest at "write".
+  // fresh + k * CAPTURE_RING edges were overwritten before being read.
+  uint64_t previous = r->edge[0];
+  r->laps++;
+  r->run = 0;
+  r->read = write;
+  captureRingPush(r, now, mask);
+  uint64_t oldest = r->edge[0];
+  for (int i = 1; i < CAPTURE_RING; i++) captureRingPush(r, now, mask);
+
+  uint32_t lost = fresh;
+  uint64_t span = r->edge[0] - oldest;
+  if (span && oldest > previous) {
+    // Edges between the previous one and the oldest survivor, at the mean period
+    uint64_t missed = ((oldest - previous) * (CAPTURE_RING - 1) * 2 + span) / (2 * span) - 1;
+    if (missed > fresh) lost += (missed - fresh + CAPTURE_RING / 2) / CAPTURE_RING * CAPTURE_RING;
+  }
+  r->count += lost;
+}
+
+uint64_t captureRingPeriod(const CaptureRing * r, int both) {
+  if (both) return (r->run >= 3) ? r->edge[0] - r->edge[2] : 0;
+  return (r->run >= 2) ? r->edge[0] - r->edge[1] : 0;
+}
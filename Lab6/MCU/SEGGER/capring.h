@@ -0,0 +1,59 @@
+// capring.h
+// Timestamp ring bookkeeping for the input-capture driver
+//
+// No hardware access, so the same file builds into the host test
+// (../tools/capturetest.c).
+
+#ifndef CAPRING_H
+#define CAPRING_H
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+#define CAPTURE_RING 16 // Timestamps per channel
+
+// The DMA writes each edge's raw counter value into ring[] and wraps; a
+// drain extends the entries written since the last one to 64 bits. If more
+// than CAPTURE_RING edges came in between, the DMA has lapped the drain.
+// Fields are private to capring.c and STM32L432KC_CAPTURE.c.
+typedef struct {
+  volatile uint32_t ring[CAPTURE_RING]; // Raw counter values, written by DMA
+  int               read;        // Next ring slot to extend
+  uint32_t          last;        // Raw value of the slot before read when it was extended
+  uint64_t          edge[3];     // Newest three edges, extended; edge[0] is newest
+  uint32_t          count;       // Edges seen since captureRingInit()
+  uint32_t          run;         // Edges since the last lap, back to back in edge[]
+  uint32_t          laps;        // Drains that found the ring lapped
+} CaptureRing;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Empties the ring before the DMA starts writing slot 0.
+ *    -- now: extended time, the edge[] value until the first edge */
+void captureRingInit(CaptureRing * r, uint64_t now);
+
+/* Extends every edge written since the last drain. Each one becomes the
+ * latest time at or before "now" with its counter value, so every edge has
+ * to be drained within one counter period of arriving.
+ *
+ * A lap shows as the slot before "read" no longer holding the value it had.
+ * The surviving CAPTURE_RING edges are extended and the lost ones are
+ * counted from the gap to the previous edge at the survivors' mean period,
+ * rounded to the nearest count the write index allows (exact while the
+ * input's period varies by less than CAPTURE_RING/2 edges over the gap).
+ *    -- write: slot the DMA writes next
+ *    -- now: extended time of the drain
+ *    -- mask: counter range, 0xFFFF or 0xFFFFFFFF */
+void captureRingDrain(CaptureRing * r, int write, uint64_t now, uint32_t mask);
+
+/* Ticks between the two newest edges, or over the newest three with "both"
+ * (rising to rising with both edges captured). 0 until there are enough
+ * edges since the last lap. */
+uint64_t captureRingPeriod(const CaptureRing * r, int both);
+
+#endif // CAPRING_H
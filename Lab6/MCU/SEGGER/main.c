@@ -57,32 +57,188 @@ int updateLEDStatus(char request[], int old_ledStatus)
 // Solution Functions
 /////////////////////////////////////////////////////////////////
 
-int main(void) {
-  configureFlash();
-  configureClock();
+// Response status strings, read by the DMA while the page goes out
+static char tempStatusStr[20];
+static char ledStatusStr[20];
+static char linkStatusStr[96];
+static volatile int pageInFlight = 0;
 
-  gpioEnable(GPIO_PORT_A);
-  gpioEnable(GPIO_PORT_B);
-  
-  pinMode(LED_PIN, GPIO_OUTPUT);
+// DMA completion callback: the status strings can be rewritten
+static void pageSent(void * ctx) {
+  pageInFlight = 0;
+}
+
+// Request frames from the ESP, in place in the DMA receive ring. The USART
+// interrupt queues them and the main loop takes them in order, so requests
+// that arrive while a page is being built wait here instead of being lost.
+// Past REQUEST_QUEUE frames they are dropped and counted; the next queued
+// frame is marked so the main loop discards the line the gap broke.
+static uint8_t rxRing[RX_RING_LEN];
+static UsartFrame requestFrames[REQUEST_QUEUE];
+static uint8_t requestAfterGap[REQUEST_QUEUE];
+static volatile uint32_t requestHead = 0, requestTail = 0;
+static volatile uint32_t requestDropped = 0;
+static int requestGap = 0;
 
-  pinMode(SPI_CE, GPIO_OUTPUT);
-  pinMode(SPI_SCK, GPIO_ALT);
-  GPIOB->AFR[0] |= _VAL2FLD(GPIO_AFRL_AFSEL3, 5U);
+// Frame callback: ends at '\n', or wherever the line went idle. A dropped
+// frame's bytes stay in the ring until the next frame taken is released.
+static void requestReceived(const UsartFrame * frame, void * ctx) {
+  if (requestHead - requestTail < REQUEST_QUEUE) {
+    requestFrames[requestHead % REQUEST_QUEUE] = *frame;
+    requestAfterGap[requestHead % REQUEST_QUEUE] = requestGap;
+    requestGap = 0;
+    requestHead++;
+  } else {
+    requestDropped++;
+    requestGap = 1;
+  }
+}
+
+#if AUDIO_TONE
+// DAC engine test tone: a 440 Hz sawtooth from a 32-bit phase accumulator
+static uint8_t toneBuffer[2 * AUDIO_TONE_SAMPLES];
+
+static void toneRefill(void * half, int samples, void * ctx) {
+  static uint32_t phase = 0;
+  uint8_t * out = half;
+  for (int i = 0; i < samples; i++) {
+    out[i] = phase >> 24;
+    phase += (uint32_t) (440ULL * (1ULL << 32) / AUDIO_TONE_RATE);
+  }
+}
+#endif
 
-  pinMode(SPI_MOSI, GPIO_ALT);
-  GPIOB->AFR[0] |= _VAL2FLD(GPIO_AFRL_AFSEL5, 5U);
+// ESP link rate. The ESP steps it up at boot, one /BAUD:<rate> at a time:
+// the MCU answers /BAUD:OK at the old rate and switches, then echoes the
+// ESP's /PING:<text> probes as /PONG:<text> at the new one. /BAUD:KEEP ends
+// the trial; without it the MCU goes back after LINK_TRIAL_MS. To fall back
+// later the ESP sends zeros at LINK_BASE_BAUD, which arrive as framing
+// errors at any faster rate.
+static uint32_t linkBaud = LINK_BASE_BAUD; // Last kept rate
+static uint32_t linkTrialBaud = 0;         // Rate on trial, 0 if none
+static uint32_t linkTrialStart;
+
+// Switches once the reply has gone out at the old rate. Returns -1, with the
+// rate unchanged, if it couldn't leave within LINK_TRIAL_MS (e.g. CTS held).
+static int linkSetBaud(USART_TypeDef * USART, uint32_t baud) {
+  if (usartFlush(USART, LINK_TRIAL_MS) < 0) return -1;
+  return usartSetBaud(USART, baud, USART_CLOCK_AUTO);
+}
+
+// Undoes a trial that was never kept, or a rate with too many line errors.
+// A switch that times out leaves the state alone, so the next check retries.
+static void linkCheck(USART_TypeDef * USART, uint32_t errors) {
+  if (errors >= LINK_ERROR_LIMIT && (linkTrialBaud || linkBaud != LINK_BASE_BAUD)) {
+    if (linkSetBaud(USART, LINK_BASE_BAUD) == 0) {
+      linkTrialBaud = 0;
+      linkBaud = LINK_BASE_BAUD;
+    }
+  } else if (linkTrialBaud && millis() - linkTrialStart >= LINK_TRIAL_MS) {
+    if (linkSetBaud(USART, linkBaud) == 0) linkTrialBaud = 0;
+  }
+}
+
+// Handles the ESP's link commands, returning 1 if request was one
+int linkCommand(USART_TypeDef * USART, char request[]) {
+  char reply[BUFF_LEN + 8];
+
+  if (strncmp(request, "/PING:", 6) == 0) {
+    snprintf(reply, sizeof(reply), "/PONG:%s", request + 6);
+    sendString(USART, reply);
+  } else if (strcmp(request, "/BAUD:KEEP\n") == 0) {
+    if (linkTrialBaud) linkBaud = linkTrialBaud;
+    linkTrialBaud = 0;
+    sendString(USART, "/BAUD:KEPT\n");
+  } else if (strncmp(request, "/BAUD:", 6) == 0) {
+    uint32_t baud = strtoul(request + 6, NULL, 10);
+    int32_t error = usartBaudError(USART, baud, USART_CLOCK_AUTO);
+    if (linkTrialBaud || error == USART_BAUD_UNREACHABLE || abs(error) > USART_BAUD_TOLERANCE) {
+      sendString(USART, "/BAUD:NO\n");
+    } else {
+      sendString(USART, "/BAUD:OK\n");
+      // Without the switch there is nothing on trial; the ESP's probes at
+      // the new rate fail and it falls back by itself
+      if (linkSetBaud(USART, baud) == 0) {
+        linkTrialBaud = baud;
+        linkTrialStart = millis();
+      }
+    }
+  } else {
+    return 0;
+  }
+  return 1;
+}
 
-  pinMode(SPI_MISO, GPIO_ALT);
-  GPIOB->AFR[0] |= _VAL2FLD(GPIO_AFRL_AFSEL4, 5U);
+// Board pin-mux table: every pin the firmware uses and the driver that owns it
+const PinMux boardPins[] = {
+  {LED_PIN, GPIO_OUTPUT, 0, GPIO_SPEED_LOW, GPIO_FLOATING, "LED"},
+  {SPI_CE,  GPIO_OUTPUT, 0, GPIO_SPEED_LOW, GPIO_FLOATING, "DS1722"},
+  SPI1_PINMUX(SPI_SCK, SPI_MISO, SPI_MOSI),
+  USART1_PINMUX,
+#if LINK_FLOW
+  USART1_FLOW_PINMUX,
+#endif
+#if AUDIO_TONE
+  DAC1_PINMUX,
+#endif
+#if BENCH_FLASH
+  USART2_PINMUX,
+#endif
+};
+
+int main(void) {
+  bootMark(BOOT_RUNTIME_INIT);
+
+  configureFlash();
+  bootMark(BOOT_FLASH);
+
+#if FAST_START
+  startClockFast();
+#else
+  configureClock();
+  bootMark(BOOT_PLL);
+#endif
+
+  // Two rows claiming one pin: the conflicts are printed and no pin is
+  // touched, so there is nothing safe to run
+  if (pinMuxInit(boardPins, PINMUX_COUNT(boardPins)) != 0) {
+    while(1);
+  }
 
   RCC->APB2ENR |= (RCC_APB2ENR_TIM15EN);
   initTIM(TIM15);
+
+  // Millisecond tick for the USART timeouts
+  initTick();
+  // 64-bit cycle count for the boot profile, which waits for the first request
+  initDWT();
   
-  USART_TypeDef * USART = initUSART(USART1_ID, 125000);
+  USART_TypeDef * USART = initUSART(USART1_ID, LINK_BASE_BAUD);
+  usartSetFlowControl(USART, LINK_FLOW);
+  usartReceiveFrames(USART, rxRing, RX_RING_LEN, '\n', requestReceived, 0);
 
   // TODO: Add SPI initialization code
   initSPI(0b111, 0, 1);
+#if AUDIO_TONE
+  if (audioInit(toneBuffer, AUDIO_TONE_SAMPLES, AUDIO_FORMAT_8BIT, toneRefill, 0) == 0) {
+    audioStart(AUDIO_TONE_RATE);
+  }
+#endif
+  bootMark(BOOT_PERIPH);
+
+#if FAST_START
+  // Switch to the PLL now that it has had the peripheral init to lock
+  finishClockFast();
+  bootMark(BOOT_PLL);
+#endif
+
+#if BENCH_GPIO
+  benchGPIO();
+#endif
+#if BENCH_FLASH
+  benchFlash(initUSART(USART2_ID, BENCH_BAUD));
+#endif
+  int booted = 0;
 
   while(1) {
     /* Wait for ESP8266 to send a request.
@@ -94,15 +250,49 @@ int main(void) {
     char request[BUFF_LEN] = "                  "; // initialize to known value
     int charIndex = 0;
   
-    // Keep going until you get end of line character
-    while(inString(request, "\n") == -1) {
-      // Wait for a complete request to be transmitted before processing
-      while(!(USART->ISR & USART_ISR_RXNE));
-      request[charIndex++] = readChar(USART);
+    // Keep going until you get end of line character. The DMA stores the
+    // bytes and the character-match interrupt hands over the whole line, so
+    // the CPU sleeps until then. A line the ESP paused in comes as several
+    // idle-ended frames. Lines with line errors or zeros (the ESP's fallback
+    // signal) are dropped, as are lines missing a frame the queue had no
+    // room for, and link commands answered here.
+    uint32_t good = usartErrors(USART); // Line errors as of the last good line
+    uint32_t lineStart = good;
+    int broken = 0;
+    while(1) {
+      while (requestTail == requestHead) {
+        linkCheck(USART, usartErrors(USART) - good);
+        __WFI(); // The tick wakes this for the trial timeout
+      }
+      UsartFrame * frame = &requestFrames[requestTail % REQUEST_QUEUE];
+      if (requestAfterGap[requestTail % REQUEST_QUEUE]) broken = 1;
+      charIndex += usartFrameString(frame, &request[charIndex], BUFF_LEN - charIndex);
+      int matched = frame->matched;
+      usartReleaseFrame(USART, frame);
+      requestTail++;
+      if (!matched) continue;
+
+      // A whole line: a web request ends the wait, anything else starts over
+      if (!broken && strlen(request) == (size_t) charIndex && usartErrors(USART) == lineStart) {
+        good = lineStart;
+        if (!linkCommand(USART, request)) break;
+      }
+      linkCheck(USART, usartErrors(USART) - good);
+      lineStart = usartErrors(USART);
+      charIndex = 0;
+      broken = 0;
+    }
+
+    if (!booted) {
+      bootMark(BOOT_FIRST_REQUEST);
+      bootReport(BOOT_BUDGET_US);
+      booted = 1;
     }
 
+    // The previous page may still be going out of the status strings
+    while (pageInFlight) __WFI();
+
     // TODO: Add SPI code here for reading temperature
-    char tempStatusStr[20];
     float temp = 0;
     temp = sendResGetTemp(request, SPI_CE);
 
@@ -114,32 +304,48 @@ int main(void) {
 
     old_ledStatus = led_status;
 
-    char ledStatusStr[20];
     if (led_status == 1)
       sprintf(ledStatusStr,"LED is on!");
     else if (led_status == 0)
       sprintf(ledStatusStr,"LED is off!");
 
-    // finally, transmit the webpage over UART
-    sendString(USART, webpageStart); // webpage header code
-    sendString(USART, ledStr); // button for controlling LED
-
-    sendString(USART, "<h2>LED Status</h2>");
+    // Link health: nonzero overruns mean bytes were lost to RDR, dropped
+    // frames that requests came faster than REQUEST_QUEUE could hold
+    snprintf(linkStatusStr, sizeof(linkStatusStr), "%lu baud, %lu overruns, %lu line errors, %lu frames dropped",
+             (unsigned long) usartGetBaud(USART), (unsigned long) usartOverruns(USART),
+             (unsigned long) usartErrors(USART), (unsigned long) requestDropped);
 
+    // finally, transmit the webpage over UART. The DMA reads every fragment
+    // where it is, the constant ones straight from flash, and chains them
+    // from its interrupt; the CPU is free until pageSent() runs.
+    static UsartFragment page[] = {
+      {0, 0}, {0, 0},                 // webpageStart, ledStr
+      {"<h2>LED Status</h2>", 19},
+      {"<p>", 3}, {ledStatusStr, 0}, {"</p>", 4},
+      {0, 0},                         // tempStr
+      {"<h2>Temperature</h2>", 20},
+      {"<p>", 3}, {tempStatusStr, 0}, {"</p>", 4},
+      {"<h2>ESP Link</h2>", 17},
+      {"<p>", 3}, {linkStatusStr, 0}, {"</p>", 4},
+      {0, 0},                         // webpageEnd
+    };
+    page[0] = (UsartFragment) {webpageStart, strlen(webpageStart)};
+    page[1] = (UsartFragment) {ledStr, strlen(ledStr)};
+    page[4].len = strlen(ledStatusStr);
+    page[6] = (UsartFragment) {tempStr, strlen(tempStr)};
+    page[9].len = strlen(tempStatusStr);
+    page[13].len = strlen(linkStatusStr);
+    page[15] = (UsartFragment) {webpageEnd, strlen(webpageEnd)};
 
-    sendString(USART, "<p>");
-    sendString(USART, ledStatusStr);
-    sendString(USART, "</p>");
-
-    //Bit resolution buttons 
-    sendString(USART, tempStr);
-
-    sendString(USART, "<h2>Temperature</h2>");
-
-    sendString(USART, "<p>");
-    sendString(USART, tempStatusStr); // Update to be the formatted temperature
-    sendString(USART, "</p>");
-  
-    sendString(USART, webpageEnd);
+    // Only a started transmit calls pageSent(). If the DMA channel can't be
+    // had, report it and send the page through the TX ring instead.
+    pageInFlight = 1;
+    if (usartSendFragments(USART, page, sizeof(page) / sizeof(page[0]), pageSent, 0) < 0) {
+      pageInFlight = 0;
+      printf("page: DMA send refused, sending by interrupt\n");
+      for (int i = 0; i < (int) (sizeof(page) / sizeof(page[0])); i++) {
+        usartWriteTimeout(USART, page[i].data, page[i].len, PAGE_SEND_MS);
+      }
+    }
   }
 }
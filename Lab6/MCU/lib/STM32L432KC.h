@@ -13,12 +13,22 @@
 // Include other peripheral libraries
 
 #include "STM32L432KC_GPIO.h"
+#include "STM32L432KC_PINMUX.h"
+#include "STM32L432KC_EXTI.h"
+#include "STM32L432KC_DMA.h"
+#include "STM32L432KC_CAPTURE.h"
+#include "STM32L432KC_WAVE.h"
+#include "STM32L432KC_DAC.h"
 #include "STM32L432KC_RCC.h"
+#include "STM32L432KC_BOOT.h"
 #include "STM32L432KC_TIM.h"
+#include "STM32L432KC_TICK.h"
+#include "STM32L432KC_DWT.h"
 #include "STM32L432KC_FLASH.h"
 #include "STM32L432KC_USART.h"
 #include "STM32L432KC_SPI.h"
 #include "DS1722.h"
+#include "benchmark.h"
 #include "main.h"
 
 // Global defines
@@ -0,0 +1,46 @@
+// STM32L432KC_BOOT.h
+// Header for boot-time profiling with the DWT cycle counter
+
+#ifndef STM32L4_BOOT_H
+#define STM32L4_BOOT_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Boot phases passed to bootMark(). Each mark ends the phase it names.
+#define BOOT_SYSTEMINIT    0 // Reset_Handler -> SystemInit() returns (recorded by the startup code)
+#define BOOT_RUNTIME_INIT  1 // .data/.bss init and constructors, up to the first line of main()
+#define BOOT_FLASH         2 // configureFlash()
+#define BOOT_PLL           3 // PLL lock and switch to PLLCLK
+#define BOOT_PERIPH        4 // Pin-mux and peripheral init
+#define BOOT_FIRST_REQUEST 5 // main() -> first request handled
+#define BOOT_PHASES        6
+
+#define BOOT_MARKS 8 // Marks kept, in the order they were made
+
+// Clock after reset, used for the phase recorded before SystemCoreClock is initialized
+#define BOOT_RESET_HZ 4000000
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Timestamps the end of a boot phase with cycles() and the clock it ran at.
+ * Phases may be marked in any order, e.g. BOOT_PLL after BOOT_PERIPH in fast-start.
+ * The counter is started in Reset_Handler when built with __BOOT_PROFILE,
+ * otherwise on the first mark (and BOOT_SYSTEMINIT reads 0); it is never reset.
+ * Call initDWT() after initTick() so a late BOOT_FIRST_REQUEST survives CYCCNT wraps.
+ *    -- phase: BOOT_RUNTIME_INIT ... BOOT_FIRST_REQUEST */
+void bootMark(int phase);
+
+/* Prints every phase with its cycles and microseconds, then the total against
+ * a boot budget. Output goes through printf (SWO/RTT on this board).
+ *    -- budget_us: boot budget in microseconds, 0 for none
+ *    -- return: total boot time in microseconds */
+uint32_t bootReport(uint32_t budget_us);
+
+#endif
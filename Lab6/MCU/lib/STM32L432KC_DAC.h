@@ -0,0 +1,59 @@
+// STM32L432KC_DAC.h
+// Header for the DAC sample-playback audio engine (TIM6 trigger + circular DMA)
+
+#ifndef STM32L4_DAC_H
+#define STM32L4_DAC_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+#include "audiobuf.h" // AudioRefill and the half accounting
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+#define AUDIO_TIM         TIM6 // Basic timer whose TRGO triggers each conversion
+#define AUDIO_DMA         DMA1
+#define AUDIO_DMA_CHANNEL 3    // DAC1 channel 1 request
+
+// Sample formats. Samples are unsigned with silence at mid-scale (0x80/0x8000).
+#define AUDIO_FORMAT_8BIT  0 // uint8_t, written to DHR8R1
+#define AUDIO_FORMAT_16BIT 1 // uint16_t, written to DHR12L1 (DAC keeps the top 12 bits)
+
+#define AUDIO_RATE_MIN 8000
+#define AUDIO_RATE_MAX 48000
+
+// Board pin-mux row for the DAC1 channel 1 output
+#define DAC1_PINMUX {PA4, GPIO_ANALOG, 0, GPIO_SPEED_LOW, GPIO_FLOATING, "DAC1"}
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Sets up DAC1 channel 1, TIM6 and the DMA channel. PA4 must already be in
+ * analog mode, e.g. with DAC1_PINMUX in the board pin-mux table.
+ *    -- buffer: 2 * samples entries of the chosen format
+ *    -- samples: samples per half
+ *    -- format: AUDIO_FORMAT_8BIT or AUDIO_FORMAT_16BIT
+ *    -- refill: fills a half of the buffer
+ *    -- ctx: passed to refill
+ *    -- return: 0, or -1 if another driver holds the DMA channel */
+int audioInit(void * buffer, int samples, int format, AudioRefill refill, void * ctx);
+
+/* Fills both halves and starts playback. After this every sample is moved
+ * TIM6 -> DMA -> DAC by hardware; the CPU only runs refill once per half.
+ * Late halves are counted against cycles(), so initDWT() must have run.
+ *    -- rate_hz: sample rate, AUDIO_RATE_MIN-AUDIO_RATE_MAX
+ *    -- return: 0 on success, -1 if the rate is out of range */
+int audioStart(uint32_t rate_hz);
+
+/* Stops playback and leaves the DAC at its last sample. */
+void audioStop(void);
+
+/* Returns how many halves the DMA started before they were refilled, plus DAC
+ * DMA underruns, since audioStart(). An interrupt held off for several
+ * halves counts each one (see ../tools/audiotest.c). A refill still running
+ * when the DMA reaches its half isn't counted. */
+uint32_t audioLate(void);
+
+#endif
@@ -0,0 +1,108 @@
+// STM32L432KC_DWT.c
+// Source code for the 64-bit monotonic clock built on the DWT cycle counter
+
+#include "STM32L432KC_DWT.h"
+#include "STM32L432KC_RCC.h"
+#include "STM32L432KC_TICK.h"
+
+static uint32_t dwtLast = 0;  // CYCCNT at the last read
+static uint64_t dwtHigh = 0;  // Wraps seen, in units of 2^32 cycles
+
+// micros() = dwtBaseMicros + (cycles() - dwtBaseCycles) / cycles per us at dwtHz
+static uint64_t dwtBaseCycles = 0;
+static uint64_t dwtBaseMicros = 0;
+static uint32_t dwtHz = 0;
+
+static SoftTimer dwtExtendTimer;
+
+// Split so count * 10^6 can't overflow 64 bits
+static uint64_t cyclesToMicrosAt(uint64_t count, uint32_t hz) {
+  return (count / hz) * 1000000 + (count % hz) * 1000000 / hz;
+}
+
+// Clock listener: closes the old rate's interval and starts counting at hclk.
+// Cycles between the SYSCLK switch and this call are counted at the old rate.
+static void dwtClockChanged(uint32_t hclk, void * ctx) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint64_t now = cycles();
+  dwtBaseMicros += cyclesToMicrosAt(now - dwtBaseCycles, dwtHz);
+  dwtBaseCycles = now;
+  dwtHz = hclk;
+
+  __set_PRIMASK(primask);
+}
+
+static void dwtExtend(void * ctx) {
+  (void) cycles();
+}
+
+void initDWT(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Enable the trace block (DWT)
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;            // Start counting core clocks
+
+  if (dwtHz == 0) {
+    clockAddListener(dwtClockChanged, 0);
+    if (tickRunning()) {
+      timerInit(&dwtExtendTimer, dwtExtend, 0);
+      timerStart(&dwtExtendTimer, DWT_EXTEND_MS, DWT_EXTEND_MS);
+    }
+  }
+
+  dwtLast = DWT->CYCCNT;
+  dwtHigh = 0;
+  dwtBaseCycles = dwtLast;
+  dwtBaseMicros = 0;
+  dwtHz = SystemCoreClock;
+}
+
+uint64_t cycles(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t now = DWT->CYCCNT;
+  if (now < dwtLast) dwtHigh += 1ULL << 32; // CYCCNT wrapped since the last read
+  dwtLast = now;
+  uint64_t count = dwtHigh | now;
+
+  __set_PRIMASK(primask);
+  return count;
+}
+
+uint64_t micros(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  // Before initDWT() there is no base yet: count from CYCCNT at the current clock
+  uint32_t hz = dwtHz ? dwtHz : SystemCoreClock;
+  uint64_t us = dwtBaseMicros + cyclesToMicrosAt(cycles() - dwtBaseCycles, hz);
+
+  __set_PRIMASK(primask);
+  return us;
+}
+
+void delay_micros(uint32_t us) {
+  uint64_t wait = (uint64_t) us * SystemCoreClock / 1000000;
+  uint32_t start = DWT->CYCCNT;
+
+  // Whole CYCCNT periods first, then the remainder with a wrap-safe difference
+  while (wait > 0xFFFFFFFF) {
+    while ((uint32_t) (DWT->CYCCNT - start) < 0x80000000);
+    start += 0x80000000;
+    wait -= 0x80000000;
+  }
+  while ((uint32_t) (DWT->CYCCNT - start) < (uint32_t) wait);
+}
+
+uint64_t elapsedCycles(uint64_t since) {
+  return cycles() - since;
+}
+
+uint64_t elapsedMicros(uint64_t since) {
+  return micros() - since;
+}
+
+uint32_t cyclesToMicros(uint64_t count) {
+  return (uint32_t) cyclesToMicrosAt(count, SystemCoreClock);
+}
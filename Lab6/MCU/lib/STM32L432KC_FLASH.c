@@ -5,5 +5,41 @@
 
 void configureFlash() {
   FLASH->ACR |= FLASH_ACR_LATENCY_4WS;
-  FLASH->ACR |= FLASH_ACR_PRFTEN;
+  flashSetART(FLASH_ART_ALL);
+}
+
+void flashSetART(uint32_t mode) {
+  uint32_t acr = FLASH->ACR & ~FLASH_ART_ALL;
+
+  // Caches can only be reset while disabled (RM 3.3.4), so turn them off first
+  FLASH->ACR = acr;
+  FLASH->ACR = acr | FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+  FLASH->ACR = acr | (mode & FLASH_ART_ALL);
+}
+
+uint32_t flashGetART(void) {
+  return FLASH->ACR & FLASH_ART_ALL;
+}
+
+void flashCacheReset(void) {
+  flashSetART(flashGetART());
+}
+
+// Highest HCLK allowed for each number of wait states (RM 3.3.3, Table 12)
+static const uint32_t flashMaxHCLK[2][5] = {
+  {16000000, 32000000, 48000000, 64000000, 80000000}, // Range 1
+  { 6000000, 12000000, 18000000, 26000000, 26000000}, // Range 2
+};
+
+int flashLatency(uint32_t hclk, int vos_range) {
+  for (int ws = 0; ws < 5; ws++) {
+    if (hclk <= flashMaxHCLK[vos_range - 1][ws]) return ws;
+  }
+  return -1;
+}
+
+void setFlashLatency(int wait_states) {
+  FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | _VAL2FLD(FLASH_ACR_LATENCY, wait_states);
+  // New value must be read back before the clock is changed (RM 3.3.3)
+  while (_FLD2VAL(FLASH_ACR_LATENCY, FLASH->ACR) != (uint32_t) wait_states);
 }
\ No newline at end of file
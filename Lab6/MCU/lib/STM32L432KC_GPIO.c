@@ -101,11 +101,12 @@ void digitalWrite(int gpio_pin, int val) {
 	GPIO_TypeDef * GPIO_PORT_PTR = gpioPinToBase(gpio_pin);
 	int pin_offset = gpioPinOffset(gpio_pin);
 
+	// Single stores to BSRR/BRR so an ISR writing the same port can't be lost
 	if (val == 1) {
-		GPIO_PORT_PTR->ODR |= (1 << pin_offset);
+		GPIO_PORT_PTR->BSRR = (1 << pin_offset);
 	}
 	else if (val == 0) {
-		GPIO_PORT_PTR->ODR &= ~(1 << pin_offset);
+		GPIO_PORT_PTR->BRR = (1 << pin_offset);
 	}
 	
 }
@@ -113,8 +114,9 @@ void digitalWrite(int gpio_pin, int val) {
 void togglePin(int gpio_pin) {
 	// Get pointer to base address of the corresponding GPIO pin and pin offset
 	GPIO_TypeDef * GPIO_PORT_PTR = gpioPinToBase(gpio_pin);
-	int pin_offset = gpioPinOffset(gpio_pin);
+	uint32_t pin_mask = 1 << gpioPinOffset(gpio_pin);
 
-	// Use XOR to toggle
-	GPIO_PORT_PTR->ODR ^= (1 << pin_offset);
-}
\ No newline at end of file
+	// Reset the pin if it is high, set it if it is low
+	uint32_t odr = GPIO_PORT_PTR->ODR;
+	GPIO_PORT_PTR->BSRR = ((odr & pin_mask) << 16) | (~odr & pin_mask);
+}
@@ -2,16 +2,17 @@
 // Source code for RCC functions
 
 #include "STM32L432KC_RCC.h"
+#include "STM32L432KC_FLASH.h"
 
-void configurePLL() {
+void startPLL() {
    // Set clock to 80 MHz
    // Output freq = (src_clk) * (N/M) / P
    // (4 MHz) * (80/2) * 2  = 80 MHz
    // M:, N:, P:
    // Use HSI as PLLSRC
 
-   RCC->CR &= ~_FLD2VAL(RCC_CR_PLLON, RCC->CR); // Turn off PLL
-   while (_FLD2VAL(RCC_CR_PLLRDY, 1) != 0); // Wait till PLL is unlocked (e.g., off)
+   RCC->CR &= ~RCC_CR_PLLON; // Turn off PLL
+   while (_FLD2VAL(RCC_CR_PLLRDY, RCC->CR) != 0); // Wait till PLL is unlocked (e.g., off)
 
    // Load configuration
    RCC->PLLCFGR |= _VAL2FLD(RCC_PLLCFGR_PLLSRC, RCC_PLLCFGR_PLLSRC_MSI);
@@ -20,8 +21,14 @@ void configurePLL() {
    RCC->PLLCFGR |= _VAL2FLD(RCC_PLLCFGR_PLLR, 0b00);  // R = 2
    RCC->PLLCFGR |= RCC_PLLCFGR_PLLREN;                // Enable PLLCLK output
 
-   // Enable PLL and wait until it's locked
+   // Enable PLL, lock takes place in the background
    RCC->CR |= RCC_CR_PLLON;
+}
+
+void configurePLL() {
+   startPLL();
+
+   // Wait until the PLL is locked
    while(_FLD2VAL(RCC_CR_PLLRDY, RCC->CR) == 0);
 }
 
@@ -34,4 +41,155 @@ void configureClock(){
   while((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
 
   SystemCoreClockUpdate();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Runtime clock scaling
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static struct {
+  ClockListener listener;
+  void *        ctx;
+} clockListeners[CLOCK_LISTENERS];
+static int clockListenerCount = 0;
+
+int clockAddListener(ClockListener listener, void * ctx) {
+  if (clockListenerCount == CLOCK_LISTENERS) return -1;
+  clockListeners[clockListenerCount].listener = listener;
+  clockListeners[clockListenerCount].ctx = ctx;
+  clockListenerCount++;
+  return 0;
+}
+
+int getVoltageRange(void) {
+  return _FLD2VAL(PWR_CR1_VOS, PWR->CR1);
+}
+
+int setVoltageRange(int range) {
+  RCC->APB1ENR1 |= RCC_APB1ENR1_PWREN;
+  if (range == getVoltageRange()) return 0;
+
+  int latency = flashLatency(SystemCoreClock, range);
+  if (latency < 0) return -1;
+
+  // Going to range 2 may need more wait states at the same frequency
+  if ((uint32_t) latency > _FLD2VAL(FLASH_ACR_LATENCY, FLASH->ACR)) setFlashLatency(latency);
+
+  PWR->CR1 = (PWR->CR1 & ~PWR_CR1_VOS) | _VAL2FLD(PWR_CR1_VOS, range);
+  while (PWR->SR2 & PWR_SR2_VOSF); // Wait for the regulator to settle
+
+  setFlashLatency(latency);
+  return 0;
+}
+
+// Raises the wait states before SYSCLK speeds up to hclk
+static int clockPrepare(uint32_t hclk) {
+  int latency = flashLatency(hclk, getVoltageRange());
+  if (latency < 0) return -1;
+  if ((uint32_t) latency > _FLD2VAL(FLASH_ACR_LATENCY, FLASH->ACR)) setFlashLatency(latency);
+  return 0;
+}
+
+// Trims the wait states after SYSCLK has changed, then re-times the drivers
+static void clockFinish(void) {
+  SystemCoreClockUpdate();
+  setFlashLatency(flashLatency(SystemCoreClock, getVoltageRange()));
+
+  for (int i = 0; i < clockListenerCount; i++) {
+    clockListeners[i].listener(SystemCoreClock, clockListeners[i].ctx);
+  }
+}
+
+// Sets the MSI range while MSI is running (RM 6.2.3: only when MSIRDY = 1)
+static void msiSetRange(int range) {
+  while (!(RCC->CR & RCC_CR_MSIRDY));
+  RCC->CR = (RCC->CR & ~RCC_CR_MSIRANGE) | _VAL2FLD(RCC_CR_MSIRANGE, range) | RCC_CR_MSIRGSEL;
+}
+
+// Moves SYSCLK to MSI and waits for the switch
+static void sysclkSelectMSI(void) {
+  RCC->CFGR = RCC_CFGR_SW_MSI | (RCC->CFGR & ~RCC_CFGR_SW);
+  while((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_MSI);
+}
+
+// Parks SYSCLK on MSI at 4 MHz (the PLL input) and turns the PLL off
+static void clockParkOnMSI(void) {
+  if ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_MSI) {
+    sysclkSelectMSI();
+  }
+  RCC->CR &= ~RCC_CR_PLLON;
+  while (RCC->CR & RCC_CR_PLLRDY);
+}
+
+uint32_t clockSetMSI(int range) {
+  if (range < MSI_RANGE_100KHZ || range > MSI_RANGE_48MHZ) return 0;
+  uint32_t hclk = MSIRangeTable[range];
+
+  // MSI must not change range under a running PLL, so leave the PLL first
+  if ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_MSI) {
+    if (clockPrepare(MSIRangeTable[_FLD2VAL(RCC_CR_MSIRANGE, RCC->CR)]) < 0) return 0;
+    clockParkOnMSI();
+  }
+  if (clockPrepare(hclk) < 0) return 0;
+
+  msiSetRange(range);
+  clockFinish();
+  return SystemCoreClock;
+}
+
+uint32_t clockSetPLL(uint32_t hz) {
+  // PLLCLK = 4 MHz * N / R, with the VCO (4 MHz * N) kept in 64-344 MHz
+  const uint32_t vco_in = 4000000;
+  uint32_t best_n = 0, best_r = 0, best_err = 0xFFFFFFFF;
+
+  // VCO tops out at 344 MHz in range 1 and 128 MHz in range 2
+  const uint32_t n_max = (getVoltageRange() == 1) ? 86 : 32;
+
+  for (uint32_t r = 2; r <= 8; r += 2) {
+    uint32_t n = (hz * r + vco_in / 2) / vco_in;
+    if (n < 16 || n > n_max) continue;
+    uint32_t f = vco_in * n / r;
+    uint32_t err = (f > hz) ? f - hz : hz - f;
+    if (f <= 80000000 && err < best_err) {
+      best_err = err;
+      best_n = n;
+      best_r = r;
+    }
+  }
+  if (best_n == 0) return 0;
+  if (clockPrepare(vco_in * best_n / best_r) < 0) return 0;
+
+  // The PLL can only be reprogrammed while it is off
+  clockParkOnMSI();
+  msiSetRange(MSI_RANGE_4MHZ);
+
+  RCC->PLLCFGR = _VAL2FLD(RCC_PLLCFGR_PLLSRC, 0b01) |       // MSI
+                 _VAL2FLD(RCC_PLLCFGR_PLLM, 0) |            // M = 1
+                 _VAL2FLD(RCC_PLLCFGR_PLLN, best_n) |
+                 _VAL2FLD(RCC_PLLCFGR_PLLR, best_r / 2 - 1) |
+                 RCC_PLLCFGR_PLLREN;
+  RCC->CR |= RCC_CR_PLLON;
+  while (!(RCC->CR & RCC_CR_PLLRDY));
+
+  RCC->CFGR = RCC_CFGR_SW_PLL | (RCC->CFGR & ~RCC_CFGR_SW);
+  while((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+
+  clockFinish();
+  return SystemCoreClock;
+}
+
+void startClockFast(){
+  // SYSCLK stays on MSI while the PLL locks
+  startPLL();
+}
+
+void finishClockFast(){
+  while(_FLD2VAL(RCC_CR_PLLRDY, RCC->CR) == 0);
+
+  clockPrepare(80000000);
+  RCC->CFGR = RCC_CFGR_SW_PLL | (RCC->CFGR & ~RCC_CFGR_SW);
+  while((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+
+  // Re-times the peripherals that were started on MSI
+  clockFinish();
 }
\ No newline at end of file
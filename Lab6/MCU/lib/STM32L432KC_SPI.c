@@ -6,32 +6,31 @@
 #include "STM32L432KC_GPIO.h"
 #include "STM32L432KC_RCC.h"
 
+// SCK frequency requested by initSPI(), kept so BR can follow clock changes
+static uint32_t spiSck;
+
+// Clock listener: picks the fastest BR that keeps SCK at or below the original rate
+static void spiClockChanged(uint32_t hclk, void * ctx) {
+    int br = 0;
+    while (br < 7 && (hclk >> (br + 1)) > spiSck) br++;
+
+    while(SPI1->SR & SPI_SR_BSY); // Wait for the transfer in flight
+    SPI1->CR1 &= ~SPI_CR1_SPE;    // BR can only change with the SPI disabled
+    SPI1->CR1 = (SPI1->CR1 & ~SPI_CR1_BR) | _VAL2FLD(SPI_CR1_BR, br);
+    SPI1->CR1 |= SPI_CR1_SPE;
+}
+
 /* Enables the SPI peripheral and intializes its clock speed (baud rate), polarity, and phase.
  *    -- br: (0b000 - 0b111). The SPI clk will be the master clock / 2^(BR+1).
  *    -- cpol: clock polarity (0: inactive state is logical 0, 1: inactive state is logical 1).
  *    -- cpha: clock phase (0: data captured on leading edge of clk and changed on next edge, 
  *          1: data changed on leading edge of clk and captured on next edge)
- * Refer to the datasheet for more low-level details. */ 
+ * Refer to the datasheet for more low-level details.
+ * The SPI pins must already be configured, e.g. with SPI1_PINMUX in the board pin-mux table. */ 
 void initSPI(int br, int cpol, int cpha) {
-    // Turn on GPIOA and GPIOB clock domains (GPIOAEN and GPIOBEN bits in AHB1ENR)
-    RCC->AHB2ENR |= (RCC_AHB2ENR_GPIOAEN | RCC_AHB2ENR_GPIOBEN);
-    
+    // Pins (SPI1_PINMUX and the CE output) are set up by the board pin-mux table
     RCC->APB2ENR |= RCC_APB2ENR_SPI1EN; // Turn on SPI1 clock domain (SPI1EN bit in APB2ENR)
 
-    // Initially assigning SPI pins
-    pinMode(SPI_SCK, GPIO_ALT); // SPI1_SCK
-    pinMode(SPI_MISO, GPIO_ALT); // SPI1_MISO
-    pinMode(SPI_MOSI, GPIO_ALT); // SPI1_MOSI
-    pinMode(SPI_CE, GPIO_OUTPUT); //  Manual CS
-
-    // Set output speed type to high for SCK
-    GPIOB->OSPEEDR |= (GPIO_OSPEEDR_OSPEED3);
-
-    // Set to AF05 for SPI alternate functions
-    GPIOB->AFR[0] |= _VAL2FLD(GPIO_AFRL_AFSEL3, 5U);
-    GPIOB->AFR[0] |= _VAL2FLD(GPIO_AFRL_AFSEL4, 5U);
-    GPIOB->AFR[0] |= _VAL2FLD(GPIO_AFRL_AFSEL5, 5U);
-    
     SPI1->CR1 |= _VAL2FLD(SPI_CR1_BR, br); // Set baud rate divider
 
     SPI1->CR1 |= (SPI_CR1_MSTR);
@@ -42,6 +41,9 @@ void initSPI(int br, int cpol, int cpha) {
     SPI1->CR2 |= (SPI_CR2_FRXTH | SPI_CR2_SSOE);
 
     SPI1->CR1 |= (SPI_CR1_SPE); // Enable SPI
+
+    if (spiSck == 0) clockAddListener(spiClockChanged, 0);
+    spiSck = SystemCoreClock >> (br + 1);
 }
 
 /* Transmits a character (1 byte) over SPI and returns the received character.
@@ -0,0 +1,159 @@
+// STM32L432KC_TICK.c
+// Source code for the SysTick millisecond tick and software timers
+
+#include "STM32L432KC_TICK.h"
+#include "STM32L432KC_RCC.h"
+
+#define WHEEL_MASK (TICK_WHEEL_SLOTS - 1)
+#define WHEEL_SPAN (1UL << (TICK_WHEEL_BITS * TICK_WHEEL_LEVELS)) // Ticks covered by the wheel
+
+// Slot heads are sentinels of circular doubly-linked lists, so insert and
+// unlink need no empty-list special cases
+typedef struct {
+  SoftTimer * next;
+  SoftTimer * prev;
+} TimerList;
+
+static TimerList wheel[TICK_WHEEL_LEVELS][TICK_WHEEL_SLOTS];
+static volatile uint32_t tickCount = 0; // Last tick processed by SysTick_Handler
+static int tickStarted = 0;
+
+// Clock listener: keeps SysTick at 1 kHz
+static void tickClockChanged(uint32_t hclk, void * ctx) {
+  SysTick->LOAD = hclk / 1000 - 1;
+  SysTick->VAL = 0;
+}
+
+void initTick(void) {
+  for (int level = 0; level < TICK_WHEEL_LEVELS; level++) {
+    for (int slot = 0; slot < TICK_WHEEL_SLOTS; slot++) {
+      wheel[level][slot].next = wheel[level][slot].prev = (SoftTimer *) &wheel[level][slot];
+    }
+  }
+
+  SysTick_Config(SystemCoreClock / 1000); // Also gives SysTick the lowest priority
+  if (!tickStarted) clockAddListener(tickClockChanged, 0);
+  tickStarted = 1;
+}
+
+int tickRunning(void) {
+  return tickStarted;
+}
+
+uint32_t millis(void) {
+  return tickCount;
+}
+
+void tickDelay(uint32_t ms) {
+  uint32_t start = tickCount;
+  // One extra tick so a partial first millisecond doesn't count
+  while ((tickCount - start) <= ms) __WFI();
+}
+
+// Links timer into the slot for its expiry, relative to the current tick.
+// Caller holds interrupts off.
+static void wheelInsert(SoftTimer * timer) {
+  uint32_t expires = timer->expires;
+  uint32_t delta = expires - tickCount;
+  int level = 0;
+
+  // Too far out for the wheel: park it in the top level and re-cascade later
+  if (delta >= WHEEL_SPAN) {
+    expires = tickCount + WHEEL_SPAN - 1;
+    delta = WHEEL_SPAN - 1;
+  }
+  while (level < TICK_WHEEL_LEVELS - 1 && delta >= (1UL << (TICK_WHEEL_BITS * (level + 1)))) level++;
+
+  TimerList * head = &wheel[level][(expires >> (TICK_WHEEL_BITS * level)) & WHEEL_MASK];
+  timer->next = (SoftTimer *) head;
+  timer->prev = head->prev;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+// Caller holds interrupts off
+static void wheelUnlink(SoftTimer * timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->next = timer->prev = 0;
+}
+
+void timerInit(SoftTimer * timer, TimerCallback callback, void * ctx) {
+  timer->next = timer->prev = 0;
+  timer->expires = 0;
+  timer->period = 0;
+  timer->callback = callback;
+  timer->ctx = ctx;
+  timer->fired = 0;
+}
+
+void timerStart(SoftTimer * timer, uint32_t ms, uint32_t period_ms) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (timer->next) wheelUnlink(timer);
+  timer->expires = tickCount + (ms ? ms : 1);
+  timer->period = period_ms;
+  wheelInsert(timer);
+
+  __set_PRIMASK(primask);
+}
+
+void timerCancel(SoftTimer * timer) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (timer->next) wheelUnlink(timer);
+
+  __set_PRIMASK(primask);
+}
+
+int timerActive(const SoftTimer * timer) {
+  return timer->next != 0;
+}
+
+uint32_t timerFired(SoftTimer * timer) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t fired = timer->fired;
+  timer->fired = 0;
+
+  __set_PRIMASK(primask);
+  return fired;
+}
+
+// Moves every timer in a slot of an upper level down to where it now belongs
+static void wheelCascade(int level, int slot) {
+  TimerList * head = &wheel[level][slot];
+
+  while (head->next != (SoftTimer *) head) {
+    SoftTimer * timer = head->next;
+    wheelUnlink(timer);
+    wheelInsert(timer);
+  }
+}
+
+void SysTick_Handler(void) {
+  uint32_t now = ++tickCount;
+
+  // Each time a level wraps, the next slot of the level above is due to be split up
+  for (int level = 1; level < TICK_WHEEL_LEVELS; level++) {
+    if ((now >> (TICK_WHEEL_BITS * (level - 1))) & WHEEL_MASK) break;
+    wheelCascade(level, (now >> (TICK_WHEEL_BITS * level)) & WHEEL_MASK);
+  }
+
+  // Everything left in this level 0 slot expires now
+  TimerList * head = &wheel[0][now & WHEEL_MASK];
+  while (head->next != (SoftTimer *) head) {
+    SoftTimer * timer = head->next;
+    wheelUnlink(timer);
+
+    if (timer->period) {
+      timer->expires += timer->period; // Keeps the period drift-free
+      wheelInsert(timer);
+    }
+    timer->fired++;
+    if (timer->callback) timer->callback(timer->ctx);
+  }
+}
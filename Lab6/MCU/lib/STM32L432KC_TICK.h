@@ -0,0 +1,72 @@
+// STM32L432KC_TICK.h
+// Header for the SysTick millisecond tick and software timers
+
+#ifndef STM32L4_TICK_H
+#define STM32L4_TICK_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// Timer wheel geometry: 4 levels of 64 slots, each level 64x coarser than the
+// one below, reaching 2^24 ms (~4.6 hours). Longer timers are re-cascaded.
+#define TICK_WHEEL_BITS   6
+#define TICK_WHEEL_SLOTS  (1 << TICK_WHEEL_BITS)
+#define TICK_WHEEL_LEVELS 4
+
+/* Timer expiry callback. Runs inside SysTick_Handler, so it should be short;
+ * longer work should poll timerFired() from the main loop instead.
+ *    -- ctx: the pointer passed to timerInit() */
+typedef void (*TimerCallback)(void * ctx);
+
+// Software timer. Allocated by the caller, linked into the wheel while active.
+typedef struct SoftTimer {
+  struct SoftTimer * next;
+  struct SoftTimer * prev;
+  uint32_t           expires;   // Tick the timer fires on
+  uint32_t           period;    // Reload in ms, 0 for one-shot
+  TimerCallback      callback;  // 0 for flag-only delivery
+  void *             ctx;
+  volatile uint32_t  fired;     // Expiries not yet collected by timerFired()
+} SoftTimer;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Starts SysTick at 1 kHz from SystemCoreClock. The reload follows later clock
+ * changes made through clockSetMSI()/clockSetPLL(). */
+void initTick(void);
+
+/* Returns 1 once initTick() has run. */
+int tickRunning(void);
+
+/* Returns milliseconds since initTick(). Wraps after ~49 days. */
+uint32_t millis(void);
+
+/* Sleeps (WFI) for at least ms milliseconds. */
+void tickDelay(uint32_t ms);
+
+/* Prepares a timer. Must be called once before timerStart().
+ *    -- callback: called on expiry from SysTick_Handler, or 0 to only set the flag
+ *    -- ctx: passed to callback */
+void timerInit(SoftTimer * timer, TimerCallback callback, void * ctx);
+
+/* (Re)starts a timer in O(1). A running timer is cancelled first.
+ *    -- ms: delay to the first expiry (0 is rounded up to 1)
+ *    -- period_ms: reload after each expiry, 0 for one-shot */
+void timerStart(SoftTimer * timer, uint32_t ms, uint32_t period_ms);
+
+/* Stops a timer in O(1). Safe to call on a timer that isn't running. */
+void timerCancel(SoftTimer * timer);
+
+/* Returns 1 while a timer is waiting to expire. */
+int timerActive(const SoftTimer * timer);
+
+/* Returns how many times the timer expired since the last call, and clears it. */
+uint32_t timerFired(SoftTimer * timer);
+
+#endif
@@ -3,24 +3,124 @@
 
 #include "STM32L432KC_TIM.h"
 #include "STM32L432KC_RCC.h"
+#include "STM32L432KC_TICK.h"
 
-void initTIM(TIM_TypeDef * TIMx){
-  // Set prescaler to give 1 ms time base
-  uint32_t psc_div = (uint32_t) ((SystemCoreClock/1e3));
+#define TIM_TRACKED 4 // Timers re-timed after clock changes
+
+// Timers started by initTIM()/initTIMRate() and the rate each one needs
+static struct {
+  TIM_TypeDef * TIMx;
+  uint32_t      hz;
+  int           set_arr; // 0: hz is the counter tick (PSC only), 1: hz is the update rate
+  uint32_t      scale;   // set_arr 0: counts per tick, see timSetTick()
+} timTracked[TIM_TRACKED];
+
+// Loads PSC and ARR for update events at rate_hz, using the smallest prescaler
+// that keeps ARR within 16 bits for the finest rate resolution. Rates above
+// SystemCoreClock/2 are clamped to it (ARR 1).
+static void timSetRate(TIM_TypeDef * TIMx, uint32_t rate_hz){
+  uint32_t ticks = SystemCoreClock / rate_hz;
+  if (ticks < 2) ticks = 2;
+  uint32_t psc_div = (ticks - 1) / 65536 + 1;
 
-  // Set prescaler division factor
   TIMx->PSC = (psc_div - 1);
+  TIMx->ARR = (ticks / psc_div) - 1;
+}
+
+// Loads PSC for a counter tick of hz. A 1 ms tick needs a prescaler above
+// 16 bits beyond 65.536 MHz, so the counter then runs "scale" times faster
+// and callers count scale counts per tick.
+//    -- return: scale, counts per tick
+static uint32_t timSetTick(TIM_TypeDef * TIMx, uint32_t hz, uint32_t hclk){
+  uint32_t div = hclk / hz;
+  if (div == 0) div = 1;
+  uint32_t scale = (div - 1) / 65536 + 1;
+
+  TIMx->PSC = div / scale - 1;
+  return scale;
+}
+
+// Clock listener: recomputes the prescalers of every tracked timer
+static void timClockChanged(uint32_t hclk, void * ctx){
+  for (int i = 0; i < TIM_TRACKED; i++) {
+    if (timTracked[i].TIMx == 0) continue;
+    if (timTracked[i].set_arr) {
+      timSetRate(timTracked[i].TIMx, timTracked[i].hz);
+    } else {
+      timTracked[i].scale = timSetTick(timTracked[i].TIMx, timTracked[i].hz, hclk);
+    }
+  }
+}
+
+// Tracking slot of TIMx, or -1
+static int timFind(TIM_TypeDef * TIMx){
+  for (int i = 0; i < TIM_TRACKED; i++) {
+    if (timTracked[i].TIMx == TIMx) return i;
+  }
+  return -1;
+}
+
+// Remembers a timer's rate so it survives clock changes
+static void timTrack(TIM_TypeDef * TIMx, uint32_t hz, int set_arr, uint32_t scale){
+  static int registered = 0;
+  int slot = timFind(TIMx);
+
+  if (slot < 0) slot = timFind(0);
+  if (slot < 0) return;
+
+  timTracked[slot].TIMx = TIMx;
+  timTracked[slot].hz = hz;
+  timTracked[slot].set_arr = set_arr;
+  timTracked[slot].scale = scale;
+
+  if (!registered) {
+    clockAddListener(timClockChanged, 0);
+    registered = 1;
+  }
+}
+
+void initTIM(TIM_TypeDef * TIMx){
+  // Set prescaler to give 1 ms time base (in scale counts above 65.536 MHz)
+  uint32_t scale = timSetTick(TIMx, 1000, SystemCoreClock);
+  timTrack(TIMx, 1000, 0, scale);
+
   // Generate an update event to update prescaler value
   TIMx->EGR |= 1;
   // Enable counter
   TIMx->CR1 |= 1; // Set CEN = 1
 }
 
+// Starts TIMx with update events at rate_hz
+void initTIMRate(TIM_TypeDef * TIMx, uint32_t rate_hz){
+  if (rate_hz == 0) return; // No rate, leave the timer stopped
+  timSetRate(TIMx, rate_hz);
+  timTrack(TIMx, rate_hz, 1, 1);
+  // Generate an update event to load PSC and ARR
+  TIMx->EGR |= 1;
+  // Enable counter
+  TIMx->CR1 |= 1; // Set CEN = 1
+}
+
 void delay_millis(TIM_TypeDef * TIMx, uint32_t ms){
-  TIMx->ARR = ms;// Set timer max count
-  TIMx->EGR |= 1;     // Force update
-  TIMx->SR &= ~(0x1); // Clear UIF
-  TIMx->CNT = 0;      // Reset count
+  // Sleep on the SysTick tick when it's running instead of spinning on UIF
+  if (tickRunning()) {
+    tickDelay(ms);
+    return;
+  }
+
+  // Counts of the initTIM() tick, in runs that fit the 16-bit ARR
+  int slot = timFind(TIMx);
+  uint64_t counts = (uint64_t) ms * ((slot < 0) ? 1 : timTracked[slot].scale);
+
+  while (counts) {
+    uint32_t n = (counts > 0xFFFF) ? 0xFFFF : (uint32_t) counts;
+    counts -= n;
+
+    TIMx->ARR = n;// Set timer max count
+    TIMx->EGR |= 1;     // Force update
+    TIMx->SR &= ~(0x1); // Clear UIF
+    TIMx->CNT = 0;      // Reset count
 
-  while(!(TIMx->SR & 1)); // Wait for UIF to go high
+    while(!(TIMx->SR & 1)); // Wait for UIF to go high
+  }
 }
\ No newline at end of file
@@ -11,15 +11,188 @@
 #define USART1_ID   1
 #define USART2_ID   2
 
+// Board pin-mux rows for each USART's TX/RX pins
+#define USART1_PINMUX \
+  {PA9,  GPIO_ALT, 7, GPIO_SPEED_LOW, GPIO_FLOATING, "USART1"}, \
+  {PA10, GPIO_ALT, 7, GPIO_SPEED_LOW, GPIO_FLOATING, "USART1"}
+#define USART2_PINMUX \
+  {PA2,  GPIO_ALT, 7, GPIO_SPEED_LOW, GPIO_FLOATING, "USART2"}, \
+  {PA15, GPIO_ALT, 3, GPIO_SPEED_LOW, GPIO_FLOATING, "USART2"}
+
+// Hardware flow control rows (AF7), for usartSetFlowControl(): CTS in from
+// the peer's RTS, RTS out to the peer's CTS. CTS is pulled down, so an
+// unconnected peer reads as ready (as without flow control) rather than
+// floating. It must not be pulled up: the ESP8266's RTS is GPIO15, a boot
+// strap that has to be low at reset or the ESP boots from the SD card.
+#define USART1_FLOW_PINMUX \
+  {PA11, GPIO_ALT, 7, GPIO_SPEED_LOW, GPIO_PULL_DOWN, "USART1"}, \
+  {PA12, GPIO_ALT, 7, GPIO_SPEED_LOW, GPIO_FLOATING,  "USART1"}
+#define USART2_FLOW_PINMUX \
+  {PA0,  GPIO_ALT, 7, GPIO_SPEED_LOW, GPIO_PULL_DOWN, "USART2"}, \
+  {PA1,  GPIO_ALT, 7, GPIO_SPEED_LOW, GPIO_FLOATING,  "USART2"}
+
+// Kernel clock for usartSetBaud(). The divider is the nearest whole number
+// of clocks per bit, 16x oversampled from 16 clocks and 8x from 8 to 15, so
+// HSI16 reaches 2 Mbaud and an 80 MHz PCLK 10 Mbaud. A PCLK-clocked USART
+// follows later clock changes.
+#define USART_CLOCK_AUTO 0 // Whichever is closer, HSI16 on a tie
+#define USART_CLOCK_HSI  1
+#define USART_CLOCK_PCLK 2
+
+// Largest rate error usartSetBaud() accepts, in ppm: each end's half of the
+// roughly 3.5 % an 8N1 receiver tolerates (RM 38.5.5)
+#define USART_BAUD_TOLERANCE 15000
+#define USART_BAUD_UNREACHABLE INT32_MIN
+
+// Each USART has a TX and an RX ring (sizes are powers of 2), serviced by
+// its interrupt. The rings are single-producer single-consumer: the caller
+// fills TX and drains RX, the IRQ does the opposite, so neither side locks.
+#define USART_TX_BUFFER 2048 // Holds the whole Lab 6 web page
+#define USART_RX_BUFFER 256
+
+// Timeouts for the blocking calls, in ms. Finite timeouts count on the
+// SysTick tick; without initTick() they never expire.
+#define USART_NO_WAIT 0
+#define USART_FOREVER 0xFFFFFFFF
+
+// DMA gather transmit: a list of fragments goes out back to back, each read
+// in place (flash strings included) and chained from the DMA interrupt.
+// USART1 uses DMA1 channel 4, USART2 DMA1 channel 7 (also TIM2 CH2/CH4
+// capture's; dmaClaim() refuses the second user).
+typedef struct {
+    const void * data;
+    uint16_t     len;
+} UsartFragment;
+
+typedef void (*UsartTxCallback)(void * ctx);
+
+// DMA frame receive: a circular DMA writes every byte into the caller's ring
+// with no CPU time per byte. A frame ends at the match character (character
+// match interrupt, CR2 ADD) or when the line goes idle for a frame time.
+// USART1 uses DMA2 channel 7 (DMA1 channel 5 is the WAVE engine's), USART2
+// DMA1 channel 6 (also TIM16 CH1 capture's). Messages that follow each
+// other closer than the interrupt latency arrive as one frame.
+#define USART_NO_MATCH -1 // End frames on idle line only
+
+// A received frame, in place in the ring. It wraps to the ring's start when
+// len[1] is nonzero.
+typedef struct {
+    const uint8_t * data[2];
+    uint16_t        len[2];
+    int             matched; // Ends with the match character, else idle ended it
+    uint32_t        end;     // Ring position past the frame, for usartReleaseFrame()
+} UsartFrame;
+
+typedef void (*UsartFrameCallback)(const UsartFrame * frame, void * ctx);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
 
 USART_TypeDef * id2Port(int USART_ID);
+// TX/RX pins must already be configured, e.g. with USART1_PINMUX in the board pin-mux table.
+// The rate is set as by usartSetBaud() with USART_CLOCK_AUTO, out of tolerance or not.
 USART_TypeDef * initUSART(int USART_ID, int baud_rate);
+
+/* Changes the rate, waiting for the frame in flight. Bytes still queued go
+ * out at the new rate; usartFlush() first to finish them at the old one.
+ *    -- clock: USART_CLOCK_AUTO, USART_CLOCK_HSI or USART_CLOCK_PCLK
+ *    -- return: 0, or -1 (nothing changed) if the error would exceed
+ *               USART_BAUD_TOLERANCE */
+int usartSetBaud(USART_TypeDef * USART, uint32_t baud, int clock);
+
+/* Error of the rate usartSetBaud() would set, without setting it.
+ *    -- return: ppm of baud, positive when fast, or USART_BAUD_UNREACHABLE */
+int32_t usartBaudError(USART_TypeDef * USART, uint32_t baud, int clock);
+
+/* Rate the USART runs at now, from its kernel clock and divider. */
+uint32_t usartGetBaud(USART_TypeDef * USART);
+
+/* Framing, noise and parity errors received since initUSART(). */
+uint32_t usartErrors(USART_TypeDef * USART);
+
+/* Turns RTS/CTS flow control on or off, waiting for the frame in flight.
+ * TX holds each byte until CTS is low. RTS goes high while RDR is unread,
+ * and, with the RX ring, while the ring is full: reception pauses there
+ * instead of dropping bytes. Frame receive keeps RTS low as long as the DMA
+ * keeps up, and a full frame ring still overwrites. The pins need
+ * USART1_FLOW_PINMUX or USART2_FLOW_PINMUX.
+ *    -- return: 0 */
+int usartSetFlowControl(USART_TypeDef * USART, int enable);
+
+/* Overrun errors (ORE) since initUSART(): bytes lost because RDR was still
+ * full when the next one arrived. Stays 0 with flow control. */
+uint32_t usartOverruns(USART_TypeDef * USART);
+
+/* Queues what fits of len bytes for transmission without waiting.
+ *    -- return: bytes queued */
+int usartWrite(USART_TypeDef * USART, const void * data, int len);
+
+/* Copies up to len received bytes without waiting.
+ *    -- return: bytes copied */
+int usartRead(USART_TypeDef * USART, void * data, int len);
+
+/* usartWrite() that waits for ring space, sleeping between interrupts.
+ *    -- timeout_ms: longest wait, or USART_FOREVER
+ *    -- return: bytes queued, less than len on timeout */
+int usartWriteTimeout(USART_TypeDef * USART, const void * data, int len, uint32_t timeout_ms);
+
+/* usartRead() that waits until len bytes have arrived.
+ *    -- timeout_ms: longest wait, or USART_FOREVER
+ *    -- return: bytes copied, less than len on timeout */
+int usartReadTimeout(USART_TypeDef * USART, void * data, int len, uint32_t timeout_ms);
+
+/* Waits until everything queued, ring and DMA, is on the wire (TC set).
+ *    -- return: 0, or -1 on timeout */
+int usartFlush(USART_TypeDef * USART, uint32_t timeout_ms);
+
+/* Bytes waiting in the RX ring. */
+int usartAvailable(USART_TypeDef * USART);
+
+/* Bytes still queued for TX. */
+int usartPending(USART_TypeDef * USART);
+
+/* Received bytes dropped because the RX ring was full. */
+uint32_t usartDropped(USART_TypeDef * USART);
+
+/* Sends count fragments by DMA without copying them. Anything already in the
+ * TX ring goes first; later writes queue behind the fragments. The list and
+ * the data must stay unchanged until the callback.
+ *    -- done: called from the DMA interrupt once the last byte has been handed
+ *             to the USART (usartFlush() waits for it to leave), or 0
+ *    -- return: 0, or -1 if a DMA transmit is already in progress or another
+ *               driver holds the TX DMA channel */
+int usartSendFragments(USART_TypeDef * USART, const UsartFragment * list, int count,
+                       UsartTxCallback done, void * ctx);
+
+/* 1 while a usartSendFragments() transmit is queued or running. */
+int usartDMABusy(USART_TypeDef * USART);
+
+/* Switches reception from the RX ring to DMA frames. Each frame's bytes stay
+ * valid until usartReleaseFrame(); bytes that arrive once the ring is full
+ * of unreleased frames overwrite the oldest and count in usartDropped().
+ *    -- ring, size: receive buffer, any size up to 65535
+ *    -- match: character that ends a frame (e.g. '\n'), or USART_NO_MATCH
+ *    -- done: called from the USART interrupt for each frame
+ *    -- return: 0, or -1 (RX ring still in use) if another driver holds the
+ *               RX DMA channel */
+int usartReceiveFrames(USART_TypeDef * USART, uint8_t * ring, int size, int match,
+                       UsartFrameCallback done, void * ctx);
+
+/* Hands a frame's ring space, and that of every frame before it, back to
+ * the DMA. */
+void usartReleaseFrame(USART_TypeDef * USART, const UsartFrame * frame);
+
+/* Copies up to max - 1 bytes of a frame to dst and terminates it.
+ *    -- return: bytes copied */
+int usartFrameString(const UsartFrame * frame, char * dst, int max);
+
+// Blocking byte and string calls, queued through the rings
 void sendChar(USART_TypeDef * USART, char data);
 char readChar(USART_TypeDef * USART);
 void sendString(USART_TypeDef * USART, char * charArray);
-void readString(USART_TypeDef * USART, char * charArray);
+// Waits for one byte, then takes the rest of what has arrived, at most max - 1
+// bytes in all, and NUL-terminates. Returns the length.
+int readString(USART_TypeDef * USART, char * charArray, int max);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+// STM32L432KC_WAVE.c
+// Source code for the DMA GPIO waveform engine
+
+#include "STM32L432KC_WAVE.h"
+#include "STM32L432KC_DMA.h"
+#include "STM32L432KC_GPIO.h"
+#include "STM32L432KC_TIM.h"
+
+#define WAVE_DMA DMA1
+
+// Update DMA request of each timer that can pace the engine (RM Table 41)
+static const struct {
+  TIM_TypeDef * TIMx;
+  int           channel;
+  int           request;
+} waveTimers[] = {
+  {TIM15, 5, DMA_REQ_TIM15_UP},
+  {TIM16, 6, DMA_REQ_TIM16_UP},
+  {TIM6,  3, DMA_REQ_TIM6_UP},
+  {TIM7,  4, DMA_REQ_TIM7_UP},
+};
+
+// Engine state. "halves_left" counts ping-pong halves still holding the old pattern.
+static struct {
+  TIM_TypeDef *    TIMx;
+  int              channel;
+  GPIO_TypeDef *   port;
+  uint32_t *       buffer;
+  int              length;
+  const uint32_t * pending;
+  volatile int     halves_left;
+} wave;
+
+// Copies a pattern into one half of the ping-pong buffer
+static void waveFill(int half, const uint32_t pattern[]) {
+  uint32_t * dst = wave.buffer + half * wave.length;
+  for (int i = 0; i < wave.length; i++) dst[i] = pattern[i];
+}
+
+static void waveIRQ(void * ctx);
+
+int waveInit(TIM_TypeDef * TIMx, int gpio_port, uint32_t buffer[], int length) {
+  int t = 0;
+  int count = sizeof(waveTimers) / sizeof(waveTimers[0]);
+
+  while (t < count && waveTimers[t].TIMx != TIMx) t++;
+  if (t == count) return -1;
+
+  if (TIMx == TIM15) RCC->APB2ENR  |= RCC_APB2ENR_TIM15EN;
+  if (TIMx == TIM16) RCC->APB2ENR  |= RCC_APB2ENR_TIM16EN;
+  if (TIMx == TIM6)  RCC->APB1ENR1 |= RCC_APB1ENR1_TIM6EN;
+  if (TIMx == TIM7)  RCC->APB1ENR1 |= RCC_APB1ENR1_TIM7EN;
+  if (TIMx->CR1 & TIM_CR1_CEN) return -1; // Someone else's, e.g. the delay timer
+  if (dmaClaim(WAVE_DMA, waveTimers[t].channel, "WAVE", waveIRQ, 0) < 0) return -1;
+
+  wave.TIMx = TIMx;
+  wave.channel = waveTimers[t].channel;
+  wave.port = gpioPortToBase(gpio_port);
+  wave.buffer = buffer;
+  wave.length = length;
+  wave.halves_left = 0;
+
+  initDMAChannel(WAVE_DMA, wave.channel, waveTimers[t].request);
+  return 0;
+}
+
+void waveStart(const uint32_t pattern[], uint32_t rate_hz) {
+  DMA_Channel_TypeDef * ch = dmaChannel(WAVE_DMA, wave.channel);
+
+  waveFill(0, pattern);
+  waveFill(1, pattern);
+
+  // 32-bit memory -> BSRR, circular over both halves
+  ch->CPAR  = (uint32_t) &wave.port->BSRR;
+  ch->CMAR  = (uint32_t) wave.buffer;
+  ch->CNDTR = 2 * wave.length;
+  ch->CCR   = _VAL2FLD(DMA_CCR_MSIZE, 0b10) | _VAL2FLD(DMA_CCR_PSIZE, 0b10) |
+              DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_DIR;
+  ch->CCR  |= DMA_CCR_EN;
+  NVIC_EnableIRQ(dmaIRQn(WAVE_DMA, wave.channel));
+
+  // Each update event requests one DMA transfer
+  wave.TIMx->DIER |= TIM_DIER_UDE;
+  initTIMRate(wave.TIMx, rate_hz);
+}
+
+void waveSetPattern(const uint32_t pattern[]) {
+  DMA_Channel_TypeDef * ch = dmaChannel(WAVE_DMA, wave.channel);
+
+  // Keep the ISR out while the request is updated
+  ch->CCR &= ~(DMA_CCR_HTIE | DMA_CCR_TCIE);
+  dmaClearFlags(WAVE_DMA, wave.channel, DMA_FLAG_GIF);
+  wave.pending = pattern;
+  wave.halves_left = 2;
+  ch->CCR |= (DMA_CCR_HTIE | DMA_CCR_TCIE);
+}
+
+int waveBusy(void) {
+  return wave.halves_left != 0;
+}
+
+void waveStop(void) {
+  wave.TIMx->DIER &= ~TIM_DIER_UDE;
+  wave.TIMx->CR1 &= ~TIM_CR1_CEN;
+  dmaRelease(WAVE_DMA, wave.channel);
+  wave.halves_left = 0;
+}
+
+// Half transfer: the DMA moved on to the second half, so refill the first.
+// Transfer complete: it wrapped to the first half, so refill the second.
+static void waveIRQ(void * ctx) {
+  uint32_t flags = dmaFlags(WAVE_DMA, wave.channel);
+  dmaClearFlags(WAVE_DMA, wave.channel, DMA_FLAG_GIF);
+
+  for (int half = 0; half < 2 && wave.halves_left; half++) {
+    if (flags & (half ? DMA_FLAG_TC : DMA_FLAG_HT)) {
+      waveFill(half, wave.pending);
+      wave.halves_left--;
+    }
+  }
+
+  // Both halves hold the new pattern, stop interrupting
+  if (!wave.halves_left) {
+    dmaChannel(WAVE_DMA, wave.channel)->CCR &= ~(DMA_CCR_HTIE | DMA_CCR_TCIE);
+  }
+}
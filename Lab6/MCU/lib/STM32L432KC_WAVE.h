@@ -0,0 +1,52 @@
+// STM32L432KC_WAVE.h
+// Header for the DMA GPIO waveform engine
+
+#ifndef STM32L4_WAVE_H
+#define STM32L4_WAVE_H
+
+#include <stdint.h>
+#include <stm32l432xx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+// A timer's update events pace a DMA1 channel, which copies one word per
+// event from a pattern table into the port's BSRR. Build the table entries
+// with GPIO_BSRR_VALUE(), e.g. one word per digit for a multiplexed display.
+// The timer picks the channel (RM Table 41):
+//   TIM15 channel 5   TIM16 channel 6   TIM6 channel 3   TIM7 channel 4
+// The timer must not be another driver's, e.g. the initTIM() delay timer,
+// and the channel is claimed with dmaClaim().
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Sets up a timer and its DMA channel for a port.
+ *    -- TIMx: TIM15, TIM16, TIM6 or TIM7, not running
+ *    -- gpio_port: GPIO port ID, e.g. GPIO_PORT_B. Pins must already be outputs.
+ *    -- buffer: ping-pong buffer of 2*length words, owned by the engine until waveStop()
+ *    -- length: number of BSRR words in one pattern
+ *    -- return: 0, or -1 if the timer can't pace DMA, is already running, or
+ *               another driver holds its channel */
+int waveInit(TIM_TypeDef * TIMx, int gpio_port, uint32_t buffer[], int length);
+
+/* Starts streaming "pattern" forever, one word every 1/rate_hz seconds.
+ * No CPU time is used while the pattern is unchanged.
+ *    -- rate_hz: words per second, more than 0 */
+void waveStart(const uint32_t pattern[], uint32_t rate_hz);
+
+/* Queues a new pattern of the same length. It is copied into each half of the
+ * ping-pong buffer once the DMA has finished reading that half, so output
+ * switches on a pattern boundary with no torn or repeated words.
+ * "pattern" must stay valid until waveBusy() returns 0. */
+void waveSetPattern(const uint32_t pattern[]);
+
+/* Returns 1 while a pattern from waveSetPattern() is still being swapped in. */
+int waveBusy(void);
+
+/* Stops the timer and DMA and frees both. The pins keep their last value. */
+void waveStop(void);
+
+#endif
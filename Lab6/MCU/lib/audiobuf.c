@@ -0,0 +1,65 @@
+// audiobuf.c
+// Ping-pong buffer bookkeeping for the DAC audio engine
+
+#include "audiobuf.h"
+
+// Writes half "written" into its slot
+static void audioBufferFill(AudioBuffer * ab) {
+  int slot = (int) (ab->written % 2);
+
+  ab->refill(ab->buffer + slot * ab->samples * ab->bytes, ab->samples, ab->ctx);
+  ab->written++;
+}
+
+void audioBufferInit(AudioBuffer * ab, void * buffer, int samples, int bytes,
+                     AudioRefill refill, void * ctx) {
+  ab->buffer = buffer;
+  ab->samples = samples;
+  ab->bytes = bytes;
+  ab->refill = refill;
+  ab->ctx = ctx;
+  ab->played = 0;
+  ab->written = 0;
+  ab->judged = 0;
+  ab->late = 0;
+}
+
+void audioBufferPrime(AudioBuffer * ab) {
+  ab->played = 0;
+  ab->written = 0;
+  ab->judged = 0;
+  audioBufferFill(ab);
+  audioBufferFill(ab);
+  ab->late = 0;
+}
+
+void audioBufferService(AudioBuffer * ab, int pos, uint32_t elapsed) {
+  uint64_t size = 2 * (uint64_t) ab->samples;
+  uint64_t guess = ab->played + elapsed;
+
+  // Samples moved: the count with the DMA at pos nearest the guess, never
+  // behind the last service
+  uint64_t played = guess - guess % size + (uint64_t) pos;
+  if (played >= size && played > guess + size / 2) played -= size;
+  else if (played + size / 2 < guess) played += size;
+  while (played < ab->played) played += size;
+  ab->played = played;
+
+  // Halves the DMA has moved at least one sample of. Those it reached before
+  // they were written played stale data.
+  uint64_t started = (played + ab->samples - 1) / ab->samples;
+  uint64_t from = (ab->judged > ab->written) ? ab->judged : ab->written;
+  if (started > from) ab->late += (uint32_t) (started - from);
+  if (started > ab->judged) ab->judged = started;
+
+  // The DMA is in half started - 1, so half "started" goes in the other slot.
+  // Right at a half's end it's in neither, so the one after fits as well.
+  // Halves it already played stale are skipped.
+  uint64_t last = (played % ab->samples == 0) ? started + 1 : started;
+  if (ab->written < started) ab->written = started;
+  while (ab->written <= last) audioBufferFill(ab);
+}
+
+void audioBufferUnderrun(AudioBuffer * ab) {
+  ab->late++;
+}
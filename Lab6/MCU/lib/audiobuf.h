@@ -0,0 +1,61 @@
+// audiobuf.h
+// Ping-pong buffer bookkeeping for the DAC audio engine
+//
+// No hardware access, so the same file builds into the host test
+// (../tools/audiotest.c).
+
+#ifndef AUDIOBUF_H
+#define AUDIOBUF_H
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Definitions
+///////////////////////////////////////////////////////////////////////////////
+
+/* Refills one half of the ping-pong buffer. Called from the DMA interrupt
+ * while the DMA plays the other half, so it has half a buffer of time.
+ *    -- half: first sample of the half to fill (uint8_t * or uint16_t *)
+ *    -- samples: samples in the half
+ *    -- ctx: the pointer passed to audioInit() */
+typedef void (*AudioRefill)(void * half, int samples, void * ctx);
+
+// Buffer state. Fields are private to audiobuf.c and STM32L432KC_DAC.c.
+// Halves are numbered in play order from audioBufferPrime(); half k sits in
+// slot k % 2 of the buffer.
+typedef struct {
+  uint8_t *         buffer;
+  int               samples;   // Per half
+  int               bytes;     // Bytes per sample
+  AudioRefill       refill;
+  void *            ctx;
+  uint64_t          played;    // Samples the DMA had moved at the last service
+  uint64_t          written;   // Halves refilled: the next refill is half "written"
+  uint64_t          judged;    // Halves the DMA started that were already checked
+  volatile uint32_t late;
+} AudioBuffer;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+///////////////////////////////////////////////////////////////////////////////
+
+/* Sets up a buffer of 2 * samples entries of bytes each. */
+void audioBufferInit(AudioBuffer * ab, void * buffer, int samples, int bytes,
+                     AudioRefill refill, void * ctx);
+
+/* Fills halves 0 and 1 and clears the counts, before the DMA starts. */
+void audioBufferPrime(AudioBuffer * ab);
+
+/* Refills the slot the DMA isn't playing with the next half, and counts every
+ * half the DMA started before it was refilled as late. The DMA's position
+ * gives the place in the buffer and the elapsed estimate the number of laps,
+ * so an interrupt held off for several halves counts each one.
+ *    -- pos: the DMA's position, the next sample it moves (0 to 2 * samples - 1)
+ *    -- elapsed: samples played since the last call or audioBufferPrime(),
+ *                from a time base, to within half a buffer */
+void audioBufferService(AudioBuffer * ab, int pos, uint32_t elapsed);
+
+/* Counts a DAC DMA underrun as a late half. */
+void audioBufferUnderrun(AudioBuffer * ab);
+
+#endif // AUDIOBUF_H
@@ -0,0 +1,187 @@
+// benchmark.c
+// Cycle-count benchmarks of the peripheral libraries
+
+#include "STM32L432KC.h"
+#include "benchmark.h"
+
+// Reference copy of the original digitalWrite(): switch lookup + ODR read-modify-write
+static void legacyDigitalWrite(int gpio_pin, int val) {
+  GPIO_TypeDef * GPIO_PORT_PTR = gpioPinToBase(gpio_pin);
+  int pin_offset = gpioPinOffset(gpio_pin);
+
+  if (val == 1) {
+    GPIO_PORT_PTR->ODR |= (1 << pin_offset);
+  }
+  else if (val == 0) {
+    GPIO_PORT_PTR->ODR &= ~(1 << pin_offset);
+  }
+}
+
+// Reference copy of the original togglePin(): ODR XOR read-modify-write
+static void legacyTogglePin(int gpio_pin) {
+  GPIO_TypeDef * GPIO_PORT_PTR = gpioPinToBase(gpio_pin);
+  GPIO_PORT_PTR->ODR ^= (1 << gpioPinOffset(gpio_pin));
+}
+
+void benchStart(void) {
+  // Benchmarks only use differences, so leave CYCCNT running for micros()/cycles()
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Enable the trace block (DWT)
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;            // Start counting core clocks
+}
+
+// Prints one benchmark row as average cycles per call with loop overhead removed
+static void benchReportN(const char * name, uint32_t cycles, uint32_t overhead, uint32_t calls) {
+  uint32_t net = (cycles > overhead) ? (cycles - overhead) : 0;
+  printf("%-28s %4lu.%02lu cycles/call\n", name,
+         (unsigned long) (net / calls),
+         (unsigned long) ((net % calls) * 100 / calls));
+}
+
+static void benchReport(const char * name, uint32_t cycles, uint32_t overhead) {
+  benchReportN(name, cycles, overhead, BENCH_ITERATIONS);
+}
+
+void benchGPIO(void) {
+  // Read the pin through a volatile so the runtime paths can't be constant folded
+  volatile int runtime_pin = BENCH_GPIO_PIN;
+  int pin = runtime_pin;
+  uint32_t start, overhead;
+
+  benchStart();
+  gpioEnable(gpioPinToPort(BENCH_GPIO_PIN));
+  pinMode(BENCH_GPIO_PIN, GPIO_OUTPUT);
+
+  printf("GPIO benchmark, %d calls each on pin %d\n", BENCH_ITERATIONS, BENCH_GPIO_PIN);
+
+  // Empty loop to subtract from every measurement
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) __asm volatile ("");
+  overhead = DWT->CYCCNT - start;
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) legacyDigitalWrite(pin, i & 1);
+  benchReport("digitalWrite (ODR RMW)", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) digitalWrite(pin, i & 1);
+  benchReport("digitalWrite (BSRR)", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) digitalWriteFast(BENCH_GPIO_PIN, i & 1);
+  benchReport("digitalWriteFast", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) legacyTogglePin(pin);
+  benchReport("togglePin (ODR RMW)", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) togglePin(pin);
+  benchReport("togglePin (BSRR)", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) togglePinFast(BENCH_GPIO_PIN);
+  benchReport("togglePinFast", DWT->CYCCNT - start, overhead);
+
+  // Whole-port access: one store/load instead of a call per pin
+  GPIO_Group group = GPIO_GROUP(gpioPinToPort(BENCH_GPIO_PIN), GPIO_PIN_MASK(BENCH_GPIO_PIN));
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) gpioWriteMask(group, i);
+  benchReport("gpioWriteMask", DWT->CYCCNT - start, overhead);
+
+  start = DWT->CYCCNT;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) runtime_pin = gpioReadMask(group);
+  benchReport("gpioReadMask", DWT->CYCCNT - start, overhead);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Flash ART accelerator
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Opening of the Lab 4 Fur Elise table: {frequency (Hz), duration (ms)}, ended by {0, 0}
+static const int benchSong[][2] = {
+{659,	125},
+{623,	125},
+{659,	125},
+{623,	125},
+{659,	125},
+{494,	125},
+{587,	125},
+{523,	125},
+{440,	250},
+{  0,	125},
+{262,	125},
+{330,	125},
+{440,	125},
+{494,	250},
+{  0,	0}};
+
+// One song() pass: the note loop and TIM16 PWM reload, minus the note delays
+static void benchSongPass(const int songArray[][2]) {
+  int i = 0;
+
+  while (!((songArray[i][1]==0)&(songArray[i][0]==0))){
+    if (songArray[i][0] > 0) {
+      uint32_t arr = SystemCoreClock / songArray[i][0] - 1;
+      TIM16->ARR  = arr;
+      TIM16->CCR1 = arr / 2; // 50% duty
+    } else {
+      TIM16->CCR1 = 0;       // Rest
+    }
+    i++;
+  }
+}
+
+static const struct {
+  const char * name;
+  uint32_t     mode;
+} benchARTModes[] = {
+  {"off",            FLASH_ART_OFF},
+  {"prefetch",       FLASH_ART_PREFETCH},
+  {"I-cache",        FLASH_ART_ICACHE},
+  {"I+D-cache",      FLASH_ART_ICACHE | FLASH_ART_DCACHE},
+  {"prefetch+I+D",   FLASH_ART_ALL},
+};
+
+void benchFlash(USART_TypeDef * USART) {
+  volatile float sink;
+  char line[] = "benchFlash 0123456789\n";
+  uint32_t start, overhead;
+  uint32_t saved_mode = flashGetART();
+
+  benchStart();
+  RCC->APB2ENR |= RCC_APB2ENR_TIM16EN; // Song kernel writes TIM16 like setTIM16_freq()
+
+  printf("Flash ART benchmark at %lu Hz, %lu wait states\n",
+         (unsigned long) SystemCoreClock, (unsigned long) _FLD2VAL(FLASH_ACR_LATENCY, FLASH->ACR));
+
+  for (unsigned m = 0; m < sizeof(benchARTModes) / sizeof(benchARTModes[0]); m++) {
+    flashSetART(benchARTModes[m].mode);
+    printf("-- ART %s\n", benchARTModes[m].name);
+
+    // Loop overhead under this mode, since the loop itself is fetched from flash
+    start = DWT->CYCCNT;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) __asm volatile ("");
+    overhead = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) sink = convertB2D((uint8_t) i, (uint8_t) (i << 4));
+    benchReport("convertB2D", DWT->CYCCNT - start, overhead);
+
+    start = DWT->CYCCNT;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) benchSongPass(benchSong);
+    benchReport("song() note loop", DWT->CYCCNT - start, overhead);
+
+    if (USART) {
+      start = DWT->CYCCNT;
+      for (int i = 0; i < BENCH_STRING_REPS; i++) sendString(USART, line);
+      usartFlush(USART, USART_FOREVER);
+      benchReportN("sendString (22 chars)", DWT->CYCCNT - start, 0, BENCH_STRING_REPS);
+    }
+  }
+
+  flashSetART(saved_mode);
+  TIM16->CCR1 = 0;
+  (void) sink;
+}
\ No newline at end of file
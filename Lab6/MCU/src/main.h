@@ -14,17 +14,40 @@
 
 #define LED_PIN PB0 // LED pin for blinking
 #define BUFF_LEN 32
+#define RX_RING_LEN 256  // DMA receive ring for ESP requests
+#define REQUEST_QUEUE 4  // Request frames waiting for the main loop
+
+#define LINK_BASE_BAUD   125000 // ESP link rate at boot and after a fallback
+#define LINK_TRIAL_MS    200    // A new rate not kept by then is undone
+#define LINK_ERROR_LIMIT 4      // Line errors between requests that force LINK_BASE_BAUD
+#define PAGE_SEND_MS     100    // Per fragment when a page goes out without DMA
+// RTS/CTS to the ESP. Off by default: it needs two wires beyond TX/RX,
+//   PA11 (USART1 CTS) <- ESP GPIO15 (U0RTS)
+//   PA12 (USART1 RTS) -> ESP GPIO13 (U0CTS)
+// and LINK_FLOW set to match in the ESP sketch. Without the wires the ESP's
+// CTS floats and its transmit can stall.
+#define LINK_FLOW        0
 
 #define SPI_CE PA5                //D9
 #define SPI_SCK PB3   // AF5      //D10
 #define SPI_MOSI PB5  // AF5      //D12
 #define SPI_MISO PB4  // AF5      //D13
 
+#define FAST_START 1          // Init peripherals on MSI while the PLL locks
+#define BOOT_BUDGET_US 1000000 // Reset to first request handled, in us
+#define BENCH_GPIO 0           // 1: run benchGPIO() at startup, printf to the debug terminal (see benchmark.h)
+#define BENCH_FLASH 0          // 1: run benchFlash() at startup, timing sendString() on USART2
+#define BENCH_BAUD 115200      // USART2 is the ST-LINK virtual COM port (PA2), not the ESP link
+#define AUDIO_TONE 0           // 1: play a 440 Hz test tone on PA4 with the DAC engine
+#define AUDIO_TONE_RATE 16000  // Tone sample rate, Hz
+#define AUDIO_TONE_SAMPLES 256 // Samples per ping-pong half
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 ///////////////////////////////////////////////////////////////////////////////
 
 int inString(char request[], char des[]);
 int updateLEDStatus(char request[], int old_ledStatus);
+int linkCommand(USART_TypeDef * USART, char request[]);
 
 #endif // MAIN_H
\ No newline at end of file
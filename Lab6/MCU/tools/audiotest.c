@@ -0,0 +1,135 @@
+// audiotest.c
+// Host test of the DAC engine's ping-pong accounting: the firmware's
+// audiobuf.c against a model of the circular DMA, with the HT/TC interrupt
+// served after a chosen latency.
+//
+// build: cc -O2 -I../lib -o audiotest audiotest.c ../lib/audiobuf.c
+// usage: audiotest [-n samples_per_half] [-h halves]
+//
+// Each refill tags its samples with the number of the half it was written
+// for, so the model can tell every half the DMA plays that wasn't refilled
+// in time. The interrupt gets the DMA position and an elapsed-samples
+// estimate that is off by up to a quarter buffer, like the firmware's
+// cycle count across a clock change. A row passes when the late count is
+// exactly the stale halves plus the DAC underruns (see main()). Exits 1 if
+// any row fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audiobuf.h"
+
+static int halfSamples = 64;
+static int runHalves = 1000;
+
+typedef struct {
+  long     halves;    // Halves played
+  long     stale;     // Halves with at least one sample that wasn't refilled in time
+  long     irqs;      // Interrupts served
+  uint32_t late;      // audioBuffer late count at the end
+} Result;
+
+// Refill: every sample holds the number of the half being written
+static void tagRefill(void * half, int samples, void * ctx) {
+  uint16_t * out = half;
+  AudioBuffer * ab = ctx;
+  for (int i = 0; i < samples; i++) out[i] = (uint16_t) ab->written;
+}
+
+// Plays halves of the buffer, one sample per tick. The DMA raises HT at the
+// middle and TC at the wrap; flags raised while an interrupt is pending merge
+// into it, like the channel's ISR bits. The interrupt runs latency ticks
+// after the first pending flag. Every underrun_every-th half (0: never) the
+// DAC reports an underrun.
+static Result simulate(int latency, int underrun_every) {
+  Result r = {0, 0, 0, 0};
+  uint16_t * buffer = calloc(2 * halfSamples, sizeof(uint16_t));
+  AudioBuffer ab;
+  int pending = 0, pos = 0, half_stale = 0;
+  long irq_at = -1, last_irq = 0;
+
+  audioBufferInit(&ab, buffer, halfSamples, sizeof(uint16_t), tagRefill, &ab);
+  audioBufferPrime(&ab);
+
+  // One DAC trigger per tick t, after the interrupt if one is due: t samples
+  // have been moved when it runs
+  long t_end = 0;
+  for (long t = 0; r.halves < runHalves; t++) {
+    if (pending && t == irq_at) {
+      long error = (r.irqs * 7) % (halfSamples + 1) - halfSamples / 2;
+      long elapsed = t - last_irq + error;
+      audioBufferService(&ab, pos, (uint32_t) (elapsed < 0 ? 0 : elapsed));
+      last_irq = t;
+      pending = 0;
+      r.irqs++;
+    }
+
+    // The DMA moves a sample and may raise HT or TC
+    if (buffer[pos] != (uint16_t) r.halves) half_stale = 1;
+    pos++;
+
+    int event = (pos == halfSamples || pos == 2 * halfSamples);
+    if (pos == 2 * halfSamples) pos = 0;
+    if (!event) continue;
+
+    r.halves++;
+    r.stale += half_stale;
+    half_stale = 0;
+    if (underrun_every && r.halves % underrun_every == 0) audioBufferUnderrun(&ab);
+
+    t_end = t + 1;
+    if (!pending) irq_at = t + 1 + latency;
+    pending = 1;
+  }
+
+  // One more service judges the halves played since the last interrupt
+  audioBufferService(&ab, pos, (uint32_t) (t_end - last_irq));
+  r.late = ab.late;
+  free(buffer);
+  return r;
+}
+
+int main(int argc, char ** argv) {
+  // Interrupt latency in hundredths of a half
+  static const int latencies[] = {0, 50, 99, 100, 150, 199, 250, 400};
+  int failed = 0;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    int v = atoi(argv[i + 1]);
+    if (!strcmp(argv[i], "-n")) halfSamples = v;
+    else if (!strcmp(argv[i], "-h")) runHalves = v;
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (halfSamples < 2 || runHalves < 4 || runHalves > 65535) {
+    fprintf(stderr, "need at least 2 samples per half and 4-65535 halves\n");
+    return 1;
+  }
+
+  printf("%d samples per half, %d halves per run\n\n", halfSamples, runHalves);
+  printf("%8s %8s %8s %8s %8s  %s\n", "latency", "irqs", "stale", "late", "underrun", "result");
+
+  for (int i = 0; i < (int) (sizeof(latencies) / sizeof(latencies[0])); i++) {
+    int latency = latencies[i] * halfSamples / 100;
+
+    for (int underruns = 0; underruns < 2; underruns++) {
+      int every = underruns ? 10 : 0;
+      Result r = simulate(latency, every);
+      uint32_t dac = every ? runHalves / every : 0;
+      uint32_t missed = r.late - dac;
+
+      // Every row, however late the interrupt: the late count is the DAC
+      // underruns plus exactly the stale halves, none missed and none extra
+      int ok = (r.late >= dac) && (missed == (uint32_t) r.stale);
+      if (latency <= halfSamples) ok &= (r.stale == 0);
+      failed |= !ok;
+
+      printf("%6.2f h %8ld %8ld %8lu %8lu  %s\n", latencies[i] / 100.0, r.irqs, r.stale,
+             (unsigned long) r.late, (unsigned long) dac, ok ? "ok" : "FAIL");
+    }
+  }
+  return failed;
+}